@@ -0,0 +1,476 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "allocator.h"
+#include "errors.h"
+
+// ============= STATIC FUNCS ===============
+static void* MallocAlloc(void* ctx, size_t size);
+static void* MallocRealloc(void* ctx, void* ptr, size_t old_size, size_t new_size);
+static void  MallocFree(void* ctx, void* ptr, size_t size);
+
+static void* PoolAlloc(void* ctx, size_t size);
+static void* PoolRealloc(void* ctx, void* ptr, size_t old_size, size_t new_size);
+static void  PoolFree(void* ctx, void* ptr, size_t size);
+
+static void* VirtualAlloc(void* ctx, size_t size);
+static void* VirtualRealloc(void* ctx, void* ptr, size_t old_size, size_t new_size);
+static void  VirtualFree(void* ctx, void* ptr, size_t size);
+
+static size_t GetSizeClass(size_t size);
+static void*  CutFromArena(StackPool* pool, size_t size);
+static void*  AllocLarge(StackPool* pool, size_t size);
+static void*  ReallocLarge(StackPool* pool, void* ptr, size_t size);
+static void   FreeLarge(StackPool* pool, void* ptr);
+static void   FreeLargeBlocks(StackPool* pool);
+static void   FreeChunks(PoolChunk* chunk);
+static int    CommitPages(StackVirtualMemory* vm, size_t size);
+//============================================
+
+const StackAllocator MALLOC_ALLOCATOR = {MallocAlloc, MallocRealloc, MallocFree, nullptr};
+
+//-----------------------------------------------------------------------------------------------------
+
+int StackPoolCtor(StackPool* pool, size_t chunk_size)
+{
+    assert(pool);
+
+    *pool = {};
+
+    pool->allocator  = {PoolAlloc, PoolRealloc, PoolFree, pool};
+    pool->chunk_size = chunk_size;
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int StackPoolDtor(StackPool* pool)
+{
+    assert(pool);
+
+    FreeLargeBlocks(pool);
+    FreeChunks(pool->chunks);
+    FreeChunks(pool->spare_chunks);
+
+    *pool = {};
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int StackPoolReset(StackPool* pool)
+{
+    assert(pool);
+
+    FreeLargeBlocks(pool);
+
+    if (pool->chunks == nullptr)
+        return (int) ERRORS::NONE;
+
+    // last chunk is cut again, other ones become spare and are cut after it
+    PoolChunk* chunk = pool->chunks->prev;
+
+    while (chunk != nullptr)
+    {
+        PoolChunk* prev    = chunk->prev;
+        chunk->prev        = pool->spare_chunks;
+        pool->spare_chunks = chunk;
+        chunk              = prev;
+    }
+
+    pool->chunks->prev = nullptr;
+    pool->cursor       = (char*)(pool->chunks + 1);
+    pool->end          = pool->cursor + pool->chunks->size;
+
+    for (size_t i = 0; i < POOL_SIZE_CLASSES; i++)
+        pool->free_lists[i] = nullptr;
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int StackVirtualMemoryCtor(StackVirtualMemory* vm, size_t reserve)
+{
+    assert(vm);
+
+    *vm = {};
+
+    vm->allocator = {VirtualAlloc, VirtualRealloc, VirtualFree, vm};
+    vm->page_size = (size_t) sysconf(_SC_PAGESIZE);
+
+    // range is aligned to huge page, so huge pages can back it from its beginning
+    size_t align    = VM_HUGE_PAGE_THRESHOLD;
+    size_t reserved = (reserve + align - 1) & ~(align - 1);
+
+    void* range = mmap(nullptr, reserved + align, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (range == MAP_FAILED)
+        return (int) ERRORS::ALLOCATE_MEMORY;
+
+    char* begin = (char*) range;
+    char* base  = (char*) (((uintptr_t) begin + align - 1) & ~(align - 1));
+
+    if (base != begin)
+        munmap(begin, (size_t) (base - begin));
+
+    munmap(base + reserved, align - (size_t) (base - begin));
+
+    vm->base     = base;
+    vm->reserved = reserved;
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int StackVirtualMemoryDtor(StackVirtualMemory* vm)
+{
+    assert(vm);
+
+    if (vm->base != nullptr)
+        munmap(vm->base, vm->reserved);
+
+    *vm = {};
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void* MallocAlloc(void* /* ctx */, size_t size)
+{
+    return malloc(size);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void* MallocRealloc(void* /* ctx */, void* ptr, size_t /* old_size */, size_t new_size)
+{
+    return realloc(ptr, new_size);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void MallocFree(void* /* ctx */, void* ptr, size_t /* size */)
+{
+    free(ptr);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void* PoolAlloc(void* ctx, size_t size)
+{
+    assert(ctx);
+
+    StackPool* pool    = (StackPool*) ctx;
+    size_t size_class  = GetSizeClass(size);
+
+    if (size_class == POOL_SIZE_CLASSES)
+        return AllocLarge(pool, size);
+
+    void* block = pool->free_lists[size_class];
+
+    if (block != nullptr)
+    {
+        pool->free_lists[size_class] = *(void**) block;
+        pool->reused_blocks++;
+
+        return block;
+    }
+
+    pool->new_blocks++;
+
+    return CutFromArena(pool, POOL_MIN_BLOCK << size_class);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void* PoolRealloc(void* ctx, void* ptr, size_t old_size, size_t new_size)
+{
+    assert(ctx);
+    assert(ptr);
+
+    size_t old_class = GetSizeClass(old_size);
+    size_t new_class = GetSizeClass(new_size);
+
+    if (old_class == POOL_SIZE_CLASSES && new_class == POOL_SIZE_CLASSES)
+        return ReallocLarge((StackPool*) ctx, ptr, new_size);
+
+    if (old_class == new_class)
+        return ptr;
+
+    void* new_ptr = PoolAlloc(ctx, new_size);
+
+    if (new_ptr == nullptr)
+        return nullptr;
+
+    memcpy(new_ptr, ptr, (old_size < new_size) ? old_size : new_size);
+
+    PoolFree(ctx, ptr, old_size);
+
+    return new_ptr;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void PoolFree(void* ctx, void* ptr, size_t size)
+{
+    assert(ctx);
+
+    if (ptr == nullptr)
+        return;
+
+    StackPool* pool    = (StackPool*) ctx;
+    size_t size_class  = GetSizeClass(size);
+
+    if (size_class == POOL_SIZE_CLASSES)
+    {
+        FreeLarge(pool, ptr);
+        return;
+    }
+
+    *(void**) ptr = pool->free_lists[size_class];
+    pool->free_lists[size_class] = ptr;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void* VirtualAlloc(void* ctx, size_t size)
+{
+    assert(ctx);
+
+    StackVirtualMemory* vm = (StackVirtualMemory*) ctx;
+
+    // range keeps only one buffer
+    if (vm->in_use || CommitPages(vm, size) != (int) ERRORS::NONE)
+        return nullptr;
+
+    vm->in_use = true;
+
+    return vm->base;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void* VirtualRealloc(void* ctx, void* ptr, size_t /* old_size */, size_t new_size)
+{
+    assert(ctx);
+
+    StackVirtualMemory* vm = (StackVirtualMemory*) ctx;
+
+    assert(ptr == vm->base);
+
+    if (CommitPages(vm, new_size) != (int) ERRORS::NONE)
+        return nullptr;
+
+    return ptr;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void VirtualFree(void* ctx, void* ptr, size_t /* size */)
+{
+    assert(ctx);
+
+    StackVirtualMemory* vm = (StackVirtualMemory*) ctx;
+
+    if (ptr == nullptr)
+        return;
+
+    assert(ptr == vm->base);
+
+    CommitPages(vm, 0);
+
+    vm->in_use = false;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static int CommitPages(StackVirtualMemory* vm, size_t size)
+{
+    assert(vm);
+
+    size_t committed = (size + vm->page_size - 1) & ~(vm->page_size - 1);
+
+    if (committed > vm->reserved)
+        return (int) ERRORS::ALLOCATE_MEMORY;
+
+    if (committed > vm->committed)
+    {
+        if (mprotect(vm->base + vm->committed, committed - vm->committed, PROT_READ | PROT_WRITE) != 0)
+            return (int) ERRORS::ALLOCATE_MEMORY;
+
+        vm->committed_bytes += committed - vm->committed;
+    }
+    else if (committed < vm->committed)
+    {
+        // released pages give memory back and become inaccessible again, next commit gets zero pages
+        madvise(vm->base + committed, vm->committed - committed, MADV_DONTNEED);
+        mprotect(vm->base + committed, vm->committed - committed, PROT_NONE);
+
+        vm->released_bytes += vm->committed - committed;
+    }
+
+    vm->committed = committed;
+
+    if (!vm->huge_pages && committed >= VM_HUGE_PAGE_THRESHOLD)
+        vm->huge_pages = madvise(vm->base, vm->reserved, MADV_HUGEPAGE) == 0;
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static size_t GetSizeClass(size_t size)
+{
+    size_t size_class = 0;
+    size_t block      = POOL_MIN_BLOCK;
+
+    while (block < size && size_class < POOL_SIZE_CLASSES)
+    {
+        block <<= 1;
+        size_class++;
+    }
+
+    return size_class;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void* CutFromArena(StackPool* pool, size_t size)
+{
+    assert(pool);
+
+    if (pool->cursor == nullptr || (size_t)(pool->end - pool->cursor) < size)
+    {
+        PoolChunk* chunk = pool->spare_chunks;
+
+        if (chunk != nullptr && chunk->size >= size)
+            pool->spare_chunks = chunk->prev;
+        else
+        {
+            size_t chunk_size = (pool->chunk_size > size) ? pool->chunk_size : size;
+
+            chunk = (PoolChunk*) malloc(sizeof(PoolChunk) + chunk_size);
+
+            if (chunk == nullptr)
+                return nullptr;
+
+            chunk->size = chunk_size;
+        }
+
+        chunk->prev = pool->chunks;
+
+        pool->chunks = chunk;
+        pool->cursor = (char*)(chunk + 1);
+        pool->end    = pool->cursor + chunk->size;
+    }
+
+    void* block = pool->cursor;
+    pool->cursor += size;
+
+    return block;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void* AllocLarge(StackPool* pool, size_t size)
+{
+    assert(pool);
+
+    PoolLargeBlock* block = (PoolLargeBlock*) malloc(sizeof(PoolLargeBlock) + size);
+
+    if (block == nullptr)
+        return nullptr;
+
+    block->prev = nullptr;
+    block->next = pool->large_blocks;
+
+    if (block->next != nullptr)
+        block->next->prev = block;
+
+    pool->large_blocks = block;
+
+    return block + 1;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void* ReallocLarge(StackPool* pool, void* ptr, size_t size)
+{
+    assert(pool);
+    assert(ptr);
+
+    PoolLargeBlock* block = (PoolLargeBlock*) realloc((PoolLargeBlock*) ptr - 1, sizeof(PoolLargeBlock) + size);
+
+    if (block == nullptr)
+        return nullptr;
+
+    // block could be moved, so its neighbours get its new address
+    if (block->prev != nullptr)
+        block->prev->next = block;
+    else
+        pool->large_blocks = block;
+
+    if (block->next != nullptr)
+        block->next->prev = block;
+
+    return block + 1;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void FreeLarge(StackPool* pool, void* ptr)
+{
+    assert(pool);
+    assert(ptr);
+
+    PoolLargeBlock* block = (PoolLargeBlock*) ptr - 1;
+
+    if (block->prev != nullptr)
+        block->prev->next = block->next;
+    else
+        pool->large_blocks = block->next;
+
+    if (block->next != nullptr)
+        block->next->prev = block->prev;
+
+    free(block);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void FreeLargeBlocks(StackPool* pool)
+{
+    assert(pool);
+
+    PoolLargeBlock* block = pool->large_blocks;
+
+    while (block != nullptr)
+    {
+        PoolLargeBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+
+    pool->large_blocks = nullptr;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void FreeChunks(PoolChunk* chunk)
+{
+    while (chunk != nullptr)
+    {
+        PoolChunk* prev = chunk->prev;
+        free(chunk);
+        chunk = prev;
+    }
+}
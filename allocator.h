@@ -0,0 +1,155 @@
+#ifndef __ALLOCATOR_H_
+#define __ALLOCATOR_H_
+
+/*! \file
+* \brief Contains stack allocators
+*/
+
+#include <stdio.h>
+
+#include "types.h"
+
+/// @brief stack memory allocator (all functions get ctx as first argument)
+struct StackAllocator
+{
+    /// allocates size bytes
+    void* (*alloc)   (void* ctx, size_t size);
+    /// reallocates block of old_size bytes to new_size bytes
+    void* (*realloc) (void* ctx, void* ptr, size_t old_size, size_t new_size);
+    /// frees block of size bytes
+    void  (*free)    (void* ctx, void* ptr, size_t size);
+    /// allocator context
+    void* ctx;
+};
+
+/// allocator, that uses malloc, realloc and free (default one)
+extern const StackAllocator MALLOC_ALLOCATOR;
+
+/// smallest block of stack pool
+static const size_t POOL_MIN_BLOCK    = 64;
+/// amount of size classes of stack pool (POOL_MIN_BLOCK << i for i-th class)
+static const size_t POOL_SIZE_CLASSES = 15;
+/// default size of stack pool arena chunk
+static const size_t POOL_CHUNK_SIZE   = 1 << 20;
+
+/// @brief chunk of stack pool arena
+struct PoolChunk
+{
+    /// previous chunk
+    PoolChunk* prev;
+    /// chunk size (without header)
+    size_t size;
+};
+
+/// @brief header of pool block, that is larger than largest size class (block is taken from malloc)
+struct PoolLargeBlock
+{
+    /// previous large block
+    PoolLargeBlock* prev;
+    /// next large block
+    PoolLargeBlock* next;
+};
+
+/// @brief size-class pool allocator for stack buffers (not thread safe)
+struct StackPool
+{
+    /// allocator, that uses this pool
+    StackAllocator allocator;
+
+    /// last arena chunk
+    PoolChunk* chunks;
+    /// chunks, that were emptied by StackPoolReset (arena takes them before it allocates new ones)
+    PoolChunk* spare_chunks;
+    /// first free byte of last chunk
+    char* cursor;
+    /// end of last chunk
+    char* end;
+    /// size of new arena chunks
+    size_t chunk_size;
+
+    /// free blocks of every size class
+    void* free_lists[POOL_SIZE_CLASSES];
+    /// blocks, that are larger than largest size class (they are released with arena)
+    PoolLargeBlock* large_blocks;
+
+    /// blocks, that were taken from free lists
+    size_t reused_blocks;
+    /// blocks, that were cut from arena
+    size_t new_blocks;
+};
+
+/************************************************************//**
+ * @brief Creates stack pool
+ *
+ * @param[in] pool pool pointer
+ * @param[in] chunk_size size of arena chunks
+ * @return int error code
+ *************************************************************/
+int StackPoolCtor(StackPool* pool, size_t chunk_size = POOL_CHUNK_SIZE);
+
+/************************************************************//**
+ * @brief Releases all memory of stack pool in one call (stacks, that use it, become invalid)
+ *
+ * @param[in] pool pool pointer
+ * @return int error code
+ *************************************************************/
+int StackPoolDtor(StackPool* pool);
+
+/************************************************************//**
+ * @brief Makes all blocks of stack pool free, but keeps arena memory (blocks, that are larger than
+ * largest size class, are released)
+ *
+ * @param[in] pool pool pointer
+ * @return int error code
+ *************************************************************/
+int StackPoolReset(StackPool* pool);
+
+/// default address range, that virtual memory allocator reserves
+static const size_t VM_RESERVE_SIZE         = (size_t) 1 << 34;
+/// committed size, from which virtual memory allocator asks for transparent huge pages
+static const size_t VM_HUGE_PAGE_THRESHOLD  = (size_t) 1 << 21;
+
+/// @brief virtual memory allocator for one stack buffer: address range is reserved once and pages are
+/// committed and released in place, so buffer never moves and its resize costs only touched pages (not thread safe)
+struct StackVirtualMemory
+{
+    /// allocator, that uses this range
+    StackAllocator allocator;
+
+    /// beginning of reserved range
+    char* base;
+    /// size of reserved range
+    size_t reserved;
+    /// size of committed part (multiple of page size)
+    size_t committed;
+    /// page size
+    size_t page_size;
+    /// buffer is given to stack
+    bool in_use;
+    /// huge pages are turned on for range
+    bool huge_pages;
+
+    /// bytes, that were committed
+    size_t committed_bytes;
+    /// bytes, that were released
+    size_t released_bytes;
+};
+
+/************************************************************//**
+ * @brief Reserves address range for virtual memory allocator (no memory is committed)
+ *
+ * @param[in] vm virtual memory allocator pointer
+ * @param[in] reserve size of address range (the largest buffer, that allocator can give)
+ * @return int error code
+ *************************************************************/
+int StackVirtualMemoryCtor(StackVirtualMemory* vm, size_t reserve = VM_RESERVE_SIZE);
+
+/************************************************************//**
+ * @brief Releases address range of virtual memory allocator (stack, that uses it, becomes invalid)
+ *
+ * @param[in] vm virtual memory allocator pointer
+ * @return int error code
+ *************************************************************/
+int StackVirtualMemoryDtor(StackVirtualMemory* vm);
+
+#endif
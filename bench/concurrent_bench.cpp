@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../concurrent_stack.h"
+
+/*! \file
+* \brief Measures throughput of concurrent stack and of mutex-protected stack by amount of threads
+*
+* Every thread pushes and pops pairs of elements, so stack stays small and all threads fight for its top.
+*/
+
+/// push/pop pairs of every thread
+static const size_t PAIRS_PER_THREAD = 1 << 20;
+
+static double GetTime();
+static double RunConcurrent(size_t threads);
+static double RunLocked(size_t threads);
+
+int main(const int argc, const char* argv[])
+{
+    size_t max_threads = (argc > 1) ? strtoull(argv[1], nullptr, 10) : std::thread::hardware_concurrency();
+
+    if (max_threads == 0)
+        max_threads = 1;
+
+    OpenLogFile("concurrent_bench");
+
+    printf("%-18s %8s %12s %12s\n", "stack", "threads", "Mops/s", "speedup");
+
+    double concurrent_base = 0;
+    double locked_base     = 0;
+
+    for (size_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        double concurrent = RunConcurrent(threads);
+        double locked     = RunLocked(threads);
+
+        if (threads == 1)
+        {
+            concurrent_base = concurrent;
+            locked_base     = locked;
+        }
+
+        printf("%-18s %8zu %12.2f %12.2f\n", "ConcurrentStack", threads, concurrent, concurrent / concurrent_base);
+        printf("%-18s %8zu %12.2f %12.2f\n", "mutex + Stack",   threads, locked,     locked / locked_base);
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static double RunConcurrent(size_t threads)
+{
+    ConcurrentStack* stk = new ConcurrentStack;
+    ConcurrentStackCtor(stk);
+
+    std::vector<std::thread> workers;
+
+    double start = GetTime();
+
+    for (size_t thread = 0; thread < threads; thread++)
+        workers.emplace_back([stk]()
+        {
+            elem_t value = 0;
+
+            for (size_t i = 0; i < PAIRS_PER_THREAD; i++)
+            {
+                ConcurrentStackPush(stk, (elem_t) i);
+                ConcurrentStackPop(stk, &value);
+            }
+        });
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    double time = GetTime() - start;
+
+    ConcurrentStackDtor(stk);
+    delete stk;
+
+    return (double) (2 * PAIRS_PER_THREAD * threads) / time * 1e-6;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static double RunLocked(size_t threads)
+{
+    Stack_t    stk  = {};
+    std::mutex lock = {};
+
+    stk.verify_level = VERIFY_OFF;
+    StackCtor(&stk);
+
+    std::vector<std::thread> workers;
+
+    double start = GetTime();
+
+    for (size_t thread = 0; thread < threads; thread++)
+        workers.emplace_back([&stk, &lock]()
+        {
+            elem_t value = 0;
+
+            for (size_t i = 0; i < PAIRS_PER_THREAD; i++)
+            {
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    StackPush(&stk, (elem_t) i);
+                }
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    StackPop(&stk, &value);
+                }
+            }
+        });
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    double time = GetTime() - start;
+
+    StackDtor(&stk);
+
+    return (double) (2 * PAIRS_PER_THREAD * threads) / time * 1e-6;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static double GetTime()
+{
+    struct timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + (double) now.tv_nsec * 1e-9;
+}
@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../hash.h"
+
+/*! \file
+* \brief Measures throughput of stack hash functions
+*/
+
+/// @brief benchmarked hash function
+struct HashCase
+{
+    /// function name
+    const char* name;
+    /// function
+    hash_f func;
+};
+
+static const HashCase HASHES[] =
+{
+    {"MurmurHash", MurmurHash},
+    {"Crc32cHash", Crc32cHash},
+    {"XxHash",     XxHash},
+};
+
+static const size_t SIZES[]       = {16, 64, 256, 4096, 65536, 1 << 20};
+static const size_t BYTES_PER_RUN = 1 << 28;
+
+static double GetTime();
+
+int main()
+{
+    size_t max_size     = SIZES[sizeof(SIZES) / sizeof(SIZES[0]) - 1];
+    unsigned char* data = (unsigned char*) malloc(max_size);
+
+    if (data == nullptr)
+        return 1;
+
+    for (size_t i = 0; i < max_size; i++)
+        data[i] = (unsigned char) (i * 131 + 7);
+
+    printf("%-12s %10s %12s %10s\n", "function", "size", "ns/hash", "GB/s");
+
+    for (const HashCase& hash : HASHES)
+    {
+        for (size_t size : SIZES)
+        {
+            size_t runs       = BYTES_PER_RUN / size;
+            volatile hash_t sink = 0;
+
+            double start = GetTime();
+
+            for (size_t i = 0; i < runs; i++)
+                sink = sink ^ hash.func(data, size);
+
+            double time = GetTime() - start;
+
+            printf("%-12s %10zu %12.2f %10.2f\n", hash.name, size,
+                   time * 1e9 / (double) runs, (double) (runs * size) / time * 1e-9);
+        }
+    }
+
+    free(data);
+
+    return 0;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static double GetTime()
+{
+    struct timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + (double) now.tv_nsec * 1e-9;
+}
@@ -0,0 +1,447 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <stack>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_RDTSC 1
+
+#else
+#define BENCH_RDTSC 0
+#endif
+
+#include "../stack.h"
+#include "../seg_stack.h"
+
+/*! \file
+* \brief Measures push/pop latency and throughput of stack (one JSON object per line)
+*
+* Protection mode is chosen by CANARY_PROTECT and HASH_PROTECT, optimization level
+* is passed in BENCH_OPT, so Makefile builds one binary for every combination.
+*/
+
+#ifndef BENCH_OPT
+#define BENCH_OPT "unknown"
+
+#endif
+
+/// default biggest stack size
+static const size_t BENCH_MAX_SIZE   = 1 << 16;
+/// minimum amount of operations of one measurement (small stacks are run several times)
+static const size_t BENCH_MIN_OPS    = 1 << 18;
+/// maximum amount of stored latency samples
+static const size_t LATENCY_SAMPLES  = 1 << 20;
+/// elements per StackPushN/StackPopN call in bulk workload
+static const size_t BULK_BATCH       = 256;
+/// amount of elements, that oscillating workload pops and pushes back
+static const size_t OSCILLATE_BURST  = 32;
+
+static const size_t SIZES[] = {16, 1024, 65536, 1 << 20, 1 << 24, 100000000};
+
+/// @brief benchmark workloads
+enum Workload
+{
+    /// push size elements in empty stack
+    PUSH,
+    /// pop size elements from full stack
+    POP,
+    /// pop and push back bursts of elements in full stack
+    OSCILLATE,
+    /// push and pop size elements by batches
+    BULK
+};
+
+static const char* WORKLOAD_NAMES[] = {"push", "pop", "oscillate", "bulk"};
+
+/// @brief result of one measurement
+struct BenchResult
+{
+    /// amount of operations (elements for bulk workload)
+    size_t ops;
+    /// time of operations
+    double seconds;
+    /// reallocations per run
+    size_t reallocs;
+    /// median latency
+    double p50_ns;
+    /// 99th percentile latency
+    double p99_ns;
+    /// worst sampled latency
+    double max_ns;
+};
+
+/// @brief latency samples
+struct Latency
+{
+    /// samples in ticks
+    unsigned long long* samples;
+    /// amount of samples
+    size_t count;
+    /// amount of operations to skip between samples
+    size_t stride;
+    /// operations since last sample
+    size_t skipped;
+};
+
+// ============= STATIC FUNCS ===============
+static double GetTime();
+static inline unsigned long long GetTicks();
+static double CalibrateTicks();
+static void PrintResult(const char* stack_name, const char* verify, Workload workload,
+                        size_t size, const BenchResult* result);
+static void CountPercentiles(Latency* latency, double ns_per_tick, BenchResult* result);
+//============================================
+
+// ============= ADAPTERS ===============
+
+/// @brief stack from stack.h
+struct CStack
+{
+    /// stack
+    Stack_t stk;
+    /// verification level
+    StackVerifyLevel level;
+
+    void   Init()                               { stk = {}; stk.verify_level = level; StackCtor(&stk); }
+    void   Destroy()                            { StackDtor(&stk); }
+    void   Push(elem_t value)                   { StackPush(&stk, value); }
+    elem_t Pop()                                { elem_t value = 0; StackPop(&stk, &value); return value; }
+    void   PushN(const elem_t* values, size_t n){ StackPushN(&stk, values, n); }
+    void   PopN(elem_t* values, size_t n)       { StackPopN(&stk, values, n); }
+    size_t Reallocs() const                     { return stk.stats.reallocs; }
+};
+
+/// @brief segmented stack from seg_stack.h
+struct CSegStack
+{
+    /// stack
+    SegStack seg;
+
+    void   Init()                               { seg = {}; SegStackCtor(&seg); }
+    void   Destroy()                            { SegStackDtor(&seg); }
+    void   Push(elem_t value)                   { SegStackPush(&seg, value); }
+    elem_t Pop()                                { elem_t value = 0; SegStackPop(&seg, &value); return value; }
+    void   PushN(const elem_t* values, size_t n){ for (size_t i = 0; i < n; i++) SegStackPush(&seg, values[i]); }
+    void   PopN(elem_t* values, size_t n)       { for (size_t i = n; i > 0; i--) SegStackPop(&seg, &values[i - 1]); }
+    size_t Reallocs() const                     { return seg.chunk_allocs; }
+};
+
+/// @brief std::vector baseline
+struct VectorStack
+{
+    /// vector
+    std::vector<elem_t> vec;
+    /// capacity changes
+    size_t reallocs;
+
+    void   Init()                               { vec = std::vector<elem_t>(); vec.reserve(MIN_CAPACITY); reallocs = 0; }
+    void   Destroy()                            { std::vector<elem_t>().swap(vec); }
+    void   Push(elem_t value)
+    {
+        if (vec.size() == vec.capacity())
+            reallocs++;
+        vec.push_back(value);
+    }
+    elem_t Pop()                                { elem_t value = vec.back(); vec.pop_back(); return value; }
+    void   PushN(const elem_t* values, size_t n)
+    {
+        if (vec.size() + n > vec.capacity())
+            reallocs++;
+        vec.insert(vec.end(), values, values + n);
+    }
+    void   PopN(elem_t* values, size_t n)
+    {
+        memcpy(values, vec.data() + vec.size() - n, n * sizeof(elem_t));
+        vec.resize(vec.size() - n);
+    }
+    size_t Reallocs() const                     { return reallocs; }
+};
+
+/// @brief std::stack baseline
+struct StdStack
+{
+    /// stack
+    std::stack<elem_t> stk;
+
+    void   Init()                               { stk = std::stack<elem_t>(); }
+    void   Destroy()                            { stk = std::stack<elem_t>(); }
+    void   Push(elem_t value)                   { stk.push(value); }
+    elem_t Pop()                                { elem_t value = stk.top(); stk.pop(); return value; }
+    void   PushN(const elem_t* values, size_t n){ for (size_t i = 0; i < n; i++) stk.push(values[i]); }
+    void   PopN(elem_t* values, size_t n)       { for (size_t i = n; i > 0; i--) { values[i - 1] = stk.top(); stk.pop(); } }
+    size_t Reallocs() const                     { return 0; }
+};
+
+//============================================
+
+#ifdef TIMED_OP
+#undef TIMED_OP
+
+#endif
+#define TIMED_OP(latency, op)   do                                                              \
+                                {                                                               \
+                                    if ((latency) != nullptr && ++(latency)->skipped >= (latency)->stride &&\
+                                        (latency)->count < LATENCY_SAMPLES)                     \
+                                    {                                                           \
+                                        unsigned long long start_ticks = GetTicks();            \
+                                        op;                                                     \
+                                        (latency)->samples[(latency)->count++] = GetTicks() - start_ticks;\
+                                        (latency)->skipped = 0;                                 \
+                                    }                                                           \
+                                    else                                                        \
+                                        op;                                                     \
+                                } while (0)
+
+/************************************************************//**
+ * @brief Runs workload once
+ *
+ * @param[in] stk stack adapter
+ * @param[in] workload workload
+ * @param[in] size stack size
+ * @param[in] batch buffer of BULK_BATCH elements
+ * @param[in] latency latency samples (nullptr if latency is not measured)
+ * @return double time of timed part
+ ************************************************************/
+template <typename S>
+static double RunOnce(S* stk, Workload workload, size_t size, elem_t* batch, Latency* latency)
+{
+    volatile elem_t sink = 0;
+
+    stk->Init();
+
+    if (workload == POP || workload == OSCILLATE)
+    {
+        for (size_t i = 0; i < size; i++)
+            stk->Push((elem_t) i);
+    }
+
+    double start = GetTime();
+
+    switch (workload)
+    {
+        case (PUSH):
+            for (size_t i = 0; i < size; i++)
+                TIMED_OP(latency, stk->Push((elem_t) i));
+            break;
+
+        case (POP):
+            for (size_t i = 0; i < size; i++)
+                TIMED_OP(latency, sink = stk->Pop());
+            break;
+
+        case (OSCILLATE):
+        {
+            size_t burst = (size < OSCILLATE_BURST) ? size : OSCILLATE_BURST;
+
+            for (size_t done = 0; done < size; done += burst)
+            {
+                for (size_t i = 0; i < burst; i++)
+                    TIMED_OP(latency, sink = stk->Pop());
+                for (size_t i = 0; i < burst; i++)
+                    TIMED_OP(latency, stk->Push((elem_t) i));
+            }
+            break;
+        }
+
+        case (BULK):
+            for (size_t done = 0; done < size; done += BULK_BATCH)
+            {
+                size_t count = std::min(BULK_BATCH, size - done);
+                TIMED_OP(latency, stk->PushN(batch, count));
+            }
+            for (size_t done = 0; done < size; done += BULK_BATCH)
+            {
+                size_t count = std::min(BULK_BATCH, size - done);
+                TIMED_OP(latency, stk->PopN(batch, count));
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    double time = GetTime() - start;
+
+    (void) sink;
+
+    return time;
+}
+
+#undef TIMED_OP
+
+/************************************************************//**
+ * @brief Measures workload throughput and latency and prints result
+ *
+ * @param[in] stack_name stack name
+ * @param[in] verify verification level name
+ * @param[in] stk stack adapter
+ * @param[in] workload workload
+ * @param[in] size stack size
+ * @param[in] latency latency buffer
+ * @param[in] ns_per_tick tick length
+ ************************************************************/
+template <typename S>
+static void Measure(const char* stack_name, const char* verify, S* stk, Workload workload, size_t size,
+                    Latency* latency, double ns_per_tick)
+{
+    static elem_t batch[BULK_BATCH] = {};
+
+    size_t ops_per_run = (workload == OSCILLATE || workload == BULK) ? 2 * size : size;
+    size_t runs        = (BENCH_MIN_OPS + ops_per_run - 1) / ops_per_run;
+
+    BenchResult result = {};
+
+    for (size_t run = 0; run < runs; run++)
+    {
+        result.seconds += RunOnce(stk, workload, size, batch, nullptr);
+        result.ops     += ops_per_run;
+        result.reallocs = stk->Reallocs();
+        stk->Destroy();
+    }
+
+    size_t timed_ops = (workload == BULK) ? 2 * ((size + BULK_BATCH - 1) / BULK_BATCH) : ops_per_run;
+
+    latency->count   = 0;
+    latency->skipped = 0;
+    latency->stride  = (timed_ops * runs + LATENCY_SAMPLES - 1) / LATENCY_SAMPLES;
+
+    for (size_t run = 0; run < runs; run++)
+    {
+        RunOnce(stk, workload, size, batch, latency);
+        stk->Destroy();
+    }
+
+    CountPercentiles(latency, ns_per_tick, &result);
+
+    PrintResult(stack_name, verify, workload, size, &result);
+}
+
+int main(const int argc, const char* argv[])
+{
+    size_t max_size = (argc > 1) ? strtoull(argv[1], nullptr, 10) : BENCH_MAX_SIZE;
+
+    OpenLogFile("stack_bench");
+
+    Latency latency = {};
+    latency.samples = (unsigned long long*) calloc(LATENCY_SAMPLES, sizeof(unsigned long long));
+
+    if (latency.samples == nullptr)
+        return 1;
+
+    double ns_per_tick = CalibrateTicks();
+
+    static const StackVerifyLevel LEVELS[]      = {VERIFY_FULL, VERIFY_SAMPLED, VERIFY_OFF};
+    static const char*            LEVEL_NAMES[] = {"full",      "sampled",      "off"};
+
+    for (size_t size : SIZES)
+    {
+        if (size > max_size)
+            break;
+
+        for (int workload = PUSH; workload <= BULK; workload++)
+        {
+            for (size_t level = 0; level < sizeof(LEVELS) / sizeof(LEVELS[0]); level++)
+            {
+                CStack stk = {};
+                stk.level  = LEVELS[level];
+                Measure("Stack", LEVEL_NAMES[level], &stk, (Workload) workload, size, &latency, ns_per_tick);
+            }
+
+            CSegStack seg = {};
+            Measure("SegStack", "top", &seg, (Workload) workload, size, &latency, ns_per_tick);
+
+            // baselines do not depend on protection mode, so they are measured once
+            #if !CANARY_PROTECT && !HASH_PROTECT
+            VectorStack vec = {};
+            Measure("std::vector", "none", &vec, (Workload) workload, size, &latency, ns_per_tick);
+
+            StdStack std_stk = {};
+            Measure("std::stack",  "none", &std_stk, (Workload) workload, size, &latency, ns_per_tick);
+            #endif
+        }
+    }
+
+    free(latency.samples);
+
+    return 0;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void PrintResult(const char* stack_name, const char* verify, Workload workload,
+                        size_t size, const BenchResult* result)
+{
+    printf("{\"opt\": \"%s\", \"canary\": %d, \"hash\": %d, \"stack\": \"%s\", \"verify\": \"%s\", "
+           "\"workload\": \"%s\", \"size\": %zu, \"ops\": %zu, \"ns_per_op\": %.3f, \"ops_per_sec\": %.0f, "
+           "\"reallocs\": %zu, \"p50_ns\": %.1f, \"p99_ns\": %.1f, \"max_ns\": %.1f}\n",
+           BENCH_OPT, CANARY_PROTECT, HASH_PROTECT, stack_name, verify,
+           WORKLOAD_NAMES[workload], size, result->ops,
+           result->seconds * 1e9 / (double) result->ops, (double) result->ops / result->seconds,
+           result->reallocs, result->p50_ns, result->p99_ns, result->max_ns);
+
+    fflush(stdout);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void CountPercentiles(Latency* latency, double ns_per_tick, BenchResult* result)
+{
+    if (latency->count == 0)
+        return;
+
+    std::sort(latency->samples, latency->samples + latency->count);
+
+    result->p50_ns = (double) latency->samples[latency->count / 2]         * ns_per_tick;
+    result->p99_ns = (double) latency->samples[latency->count * 99 / 100] * ns_per_tick;
+    result->max_ns = (double) latency->samples[latency->count - 1]         * ns_per_tick;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static double GetTime()
+{
+    struct timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + (double) now.tv_nsec * 1e-9;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline unsigned long long GetTicks()
+{
+#if BENCH_RDTSC
+    return __rdtsc();
+#else
+    struct timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (unsigned long long) now.tv_sec * 1000000000ULL + (unsigned long long) now.tv_nsec;
+#endif
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static double CalibrateTicks()
+{
+#if BENCH_RDTSC
+    const double CALIBRATION_TIME = 0.05;
+
+    double start_time              = GetTime();
+    unsigned long long start_ticks = GetTicks();
+
+    while (GetTime() - start_time < CALIBRATION_TIME)
+        ;
+
+    double time              = GetTime() - start_time;
+    unsigned long long ticks = GetTicks() - start_ticks;
+
+    return time * 1e9 / (double) ticks;
+#else
+    return 1;
+#endif
+}
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../work_deque.h"
+
+/*! \file
+* \brief Fork-join scheduler demo, that measures work stealing by amount of threads
+*
+* Task is a node of full binary tree: worker splits it, pushes right child in its own queue and goes on
+* with left child, leaves do some arithmetic. Idle workers steal tasks from random victims.
+* Scheduler runs with WorkDeque queues and with mutex-protected Stack queues.
+*/
+
+/// depth of task tree (amount of leaves is 2^TREE_DEPTH)
+static const elem_t TREE_DEPTH = 18;
+/// iterations of leaf work
+static const size_t LEAF_WORK  = 256;
+/// bits of task index in task
+static const int INDEX_BITS    = 40;
+
+/// @brief Chase-Lev deque queue
+struct DequeQueue
+{
+    /// deque
+    WorkDeque deque;
+
+    void Init()                 { WorkDequeCtor(&deque); }
+    void Destroy()              { WorkDequeDtor(&deque); }
+    void Push(elem_t task)      { WorkDequePush(&deque, task); }
+    bool Pop(elem_t* task)      { return WorkDequePop(&deque, task)   == (int) ERRORS::NONE; }
+    bool Steal(elem_t* task)    { return WorkDequeSteal(&deque, task) == (int) ERRORS::NONE; }
+};
+
+/// @brief mutex-protected stack queue (thieves pop from top too)
+struct LockedQueue
+{
+    /// stack
+    Stack_t stk;
+    /// stack lock
+    std::mutex lock;
+
+    void Init()                 { stk = {}; stk.verify_level = VERIFY_OFF; StackCtor(&stk); }
+    void Destroy()              { StackDtor(&stk); }
+    void Push(elem_t task)      { std::lock_guard<std::mutex> guard(lock); StackPush(&stk, task); }
+    bool Pop(elem_t* task)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        return stk.size != 0 && StackPop(&stk, task) == (int) ERRORS::NONE;
+    }
+    bool Steal(elem_t* task)    { return Pop(task); }
+};
+
+/// @brief scheduler state
+template <typename Q>
+struct Scheduler
+{
+    /// queue of every worker
+    std::vector<Q> queues;
+    /// tasks, that are not finished
+    std::atomic<size_t> pending;
+    /// sum of leaf results
+    std::atomic<unsigned long long> result;
+    /// stolen tasks
+    std::atomic<size_t> steals;
+};
+
+static double GetTime();
+static unsigned long long LeafWork(const elem_t index);
+static unsigned long long SerialSum();
+
+template <typename Q>
+static void Worker(Scheduler<Q>* sched, const size_t id)
+{
+    Q* own = &sched->queues[id];
+
+    unsigned long long sum = 0;
+    size_t steals          = 0;
+    uint32_t seed          = (uint32_t) id * 2654435761u + 1;
+    elem_t task            = 0;
+
+    while (sched->pending.load(std::memory_order_acquire) != 0)
+    {
+        if (!own->Pop(&task))
+        {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+
+            size_t victim = seed % sched->queues.size();
+
+            if (victim == id || !sched->queues[victim].Steal(&task))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            steals++;
+        }
+
+        elem_t level = task >> INDEX_BITS;
+        elem_t index = task & ((1LL << INDEX_BITS) - 1);
+
+        // fork: right children go to queue, worker goes on with left child
+        for (; level < TREE_DEPTH; level++, index *= 2)
+        {
+            sched->pending.fetch_add(1, std::memory_order_relaxed);
+            own->Push(((level + 1) << INDEX_BITS) | (2 * index + 1));
+        }
+
+        sum += LeafWork(index);
+
+        // join: last leaf lets workers exit
+        sched->pending.fetch_sub(1, std::memory_order_release);
+    }
+
+    sched->result.fetch_add(sum, std::memory_order_relaxed);
+    sched->steals.fetch_add(steals, std::memory_order_relaxed);
+}
+
+template <typename Q>
+static double Run(const char* name, const size_t threads, const unsigned long long expected)
+{
+    Scheduler<Q> sched;
+    sched.queues = std::vector<Q>(threads);
+    sched.pending.store(1);
+    sched.result.store(0);
+    sched.steals.store(0);
+
+    for (Q& queue : sched.queues)
+        queue.Init();
+
+    sched.queues[0].Push(0);
+
+    std::vector<std::thread> workers;
+
+    double start = GetTime();
+
+    for (size_t id = 0; id < threads; id++)
+        workers.emplace_back(Worker<Q>, &sched, id);
+
+    for (std::thread& worker : workers)
+        worker.join();
+
+    double time = GetTime() - start;
+
+    for (Q& queue : sched.queues)
+        queue.Destroy();
+
+    printf("%-14s %8zu %10.2f %10.2f %10zu %6s\n", name, threads, time * 1e3,
+           (double) (2ULL << TREE_DEPTH) / time * 1e-6, sched.steals.load(),
+           sched.result.load() == expected ? "ok" : "WRONG");
+
+    return time;
+}
+
+int main(const int argc, const char* argv[])
+{
+    size_t max_threads = (argc > 1) ? strtoull(argv[1], nullptr, 10) : std::thread::hardware_concurrency();
+
+    if (max_threads == 0)
+        max_threads = 1;
+
+    OpenLogFile("work_steal_bench");
+
+    unsigned long long expected = SerialSum();
+
+    printf("%-14s %8s %10s %10s %10s %6s\n", "queue", "threads", "ms", "Mtasks/s", "steals", "result");
+
+    for (size_t threads = 1; threads <= max_threads; threads *= 2)
+    {
+        Run<DequeQueue> ("WorkDeque",      threads, expected);
+        Run<LockedQueue>("mutex + Stack",  threads, expected);
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static unsigned long long LeafWork(const elem_t index)
+{
+    unsigned long long value = (unsigned long long) index;
+
+    for (size_t i = 0; i < LEAF_WORK; i++)
+        value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+
+    return value >> 32;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static unsigned long long SerialSum()
+{
+    unsigned long long sum = 0;
+
+    for (elem_t index = 0; index < (1LL << TREE_DEPTH); index++)
+        sum += LeafWork(index);
+
+    return sum;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static double GetTime()
+{
+    struct timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + (double) now.tv_nsec * 1e-9;
+}
@@ -0,0 +1,209 @@
+#include <assert.h>
+#include <chrono>
+
+#include "blocking_stack.h"
+#include "log_funcs.h"
+
+/// @brief how long operation waits
+enum WaitMode
+{
+    /// operation fails, if it has to wait
+    WAIT_NEVER,
+    /// operation waits until it can be done
+    WAIT_FOREVER,
+    /// operation waits until deadline
+    WAIT_TIMED
+};
+
+// ============= STATIC FUNCS ===============
+static int PushImpl(BlockingStack* bstk, const elem_t value, const WaitMode mode, const size_t timeout_us);
+static int PopImpl(BlockingStack* bstk, elem_t* ret_value, const WaitMode mode, const size_t timeout_us);
+static inline int WaitError(const WaitMode mode);
+//============================================
+
+/************************************************************//**
+ * @brief Waits on condition variable until predicate becomes true
+ *
+ * @param[in] guard locked stack lock
+ * @param[in] cond condition variable
+ * @param[in] waiting counter of waiting threads
+ * @param[in] mode wait mode
+ * @param[in] timeout_us timeout in microseconds (WAIT_TIMED mode)
+ * @param[in] ready predicate
+ * @return true predicate is true
+ * @return false operation has to wait longer, than mode allows
+ ************************************************************/
+template <typename Pred>
+static bool WaitFor(std::unique_lock<std::mutex>* guard, std::condition_variable* cond, size_t* waiting,
+                    const WaitMode mode, const size_t timeout_us, Pred ready)
+{
+    assert(guard);
+    assert(cond);
+    assert(waiting);
+
+    if (ready())
+        return true;
+
+    if (mode == WAIT_NEVER)
+        return false;
+
+    bool result = true;
+
+    (*waiting)++;
+
+    if (mode == WAIT_FOREVER)
+        cond->wait(*guard, ready);
+    else
+        result = cond->wait_for(*guard, std::chrono::microseconds(timeout_us), ready);
+
+    (*waiting)--;
+
+    return result;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int BlockingStackCtor(BlockingStack* bstk, size_t max_size, size_t capacity)
+{
+    assert(bstk);
+
+    bstk->max_size       = max_size;
+    bstk->waiting_pops   = 0;
+    bstk->waiting_pushes = 0;
+
+    return StackCtor(&bstk->stk, capacity);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int BlockingStackDtor(BlockingStack* bstk)
+{
+    assert(bstk);
+    assert(bstk->waiting_pops == 0 && bstk->waiting_pushes == 0);
+
+    return StackDtor(&bstk->stk);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int BlockingStackPush(BlockingStack* bstk, elem_t value)
+{
+    return PushImpl(bstk, value, WAIT_FOREVER, 0);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int BlockingStackTryPush(BlockingStack* bstk, elem_t value)
+{
+    return PushImpl(bstk, value, WAIT_NEVER, 0);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int BlockingStackTimedPush(BlockingStack* bstk, elem_t value, size_t timeout_us)
+{
+    return PushImpl(bstk, value, WAIT_TIMED, timeout_us);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int BlockingStackPop(BlockingStack* bstk, elem_t* ret_value)
+{
+    return PopImpl(bstk, ret_value, WAIT_FOREVER, 0);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int BlockingStackTryPop(BlockingStack* bstk, elem_t* ret_value)
+{
+    return PopImpl(bstk, ret_value, WAIT_NEVER, 0);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int BlockingStackTimedPop(BlockingStack* bstk, elem_t* ret_value, size_t timeout_us)
+{
+    return PopImpl(bstk, ret_value, WAIT_TIMED, timeout_us);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int BlockingStackDump(FILE* fp, const void* stack, const char* func, const char* file, const int line)
+{
+    assert(stack);
+    assert(func);
+    assert(file);
+
+#pragma GCC diagnostic ignored "-Wcast-qual"
+    BlockingStack* bstk = (BlockingStack*) stack;
+#pragma GCC diagnostic warning "-Wcast-qual"
+
+    std::lock_guard<std::mutex> guard(bstk->lock);
+
+    LOG_START_MOD(func, file, line);
+
+    fprintf(fp, "BlockingStack        > [%p]\n"
+                "max size             > %zu\n"
+                "waiting pops         > %zu\n"
+                "waiting pushes       > %zu\n",
+                bstk, bstk->max_size, bstk->waiting_pops, bstk->waiting_pushes);
+
+    LOG_END();
+
+    return StackDump(fp, &bstk->stk, func, file, line);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static int PushImpl(BlockingStack* bstk, const elem_t value, const WaitMode mode, const size_t timeout_us)
+{
+    assert(bstk);
+
+    std::unique_lock<std::mutex> guard(bstk->lock);
+
+    if (!WaitFor(&guard, &bstk->not_full, &bstk->waiting_pushes, mode, timeout_us,
+                 [bstk]() { return bstk->max_size == UNBOUNDED || bstk->stk.size < bstk->max_size; }))
+        return WaitError(mode);
+
+    int error = StackPush(&bstk->stk, value);
+    bool wake = bstk->waiting_pops != 0;
+
+    guard.unlock();
+
+    if (wake)
+        bstk->not_empty.notify_one();
+
+    return error;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static int PopImpl(BlockingStack* bstk, elem_t* ret_value, const WaitMode mode, const size_t timeout_us)
+{
+    assert(bstk);
+    assert(ret_value);
+
+    std::unique_lock<std::mutex> guard(bstk->lock);
+
+    // stack is checked here, so StackPop never dumps empty stack
+    if (!WaitFor(&guard, &bstk->not_empty, &bstk->waiting_pops, mode, timeout_us,
+                 [bstk]() { return bstk->stk.size != 0; }))
+        return WaitError(mode);
+
+    int error = StackPop(&bstk->stk, ret_value);
+    bool wake = bstk->waiting_pushes != 0;
+
+    guard.unlock();
+
+    if (wake)
+        bstk->not_full.notify_one();
+
+    return error;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline int WaitError(const WaitMode mode)
+{
+    return (mode == WAIT_TIMED) ? (int) ERRORS::TIMED_OUT : (int) ERRORS::WOULD_BLOCK;
+}
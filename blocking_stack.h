@@ -0,0 +1,127 @@
+#ifndef __BLOCKING_STACK_H_
+#define __BLOCKING_STACK_H_
+
+#include <stdio.h>
+#include <mutex>
+#include <condition_variable>
+
+#include "stack.h"
+
+/*! \file
+* \brief Contains thread-safe stack, which pop waits for elements and push waits for free place
+*
+* Waiting threads sleep on condition variables (futex on Linux), so idle consumers do not use CPU.
+* Push and pop notify only, if somebody waits.
+*/
+
+/// max_size of stack, which push never waits
+static const size_t UNBOUNDED = 0;
+
+/// @brief blocking stack
+struct BlockingStack
+{
+    /// stack (its fields can be set before BlockingStackCtor like before StackCtor)
+    Stack_t stk;
+    /// maximum amount of elements (UNBOUNDED for no limit)
+    size_t max_size;
+
+    /// stack lock
+    std::mutex lock;
+    /// signaled, when element is pushed
+    std::condition_variable not_empty;
+    /// signaled, when element is popped
+    std::condition_variable not_full;
+
+    /// amount of threads, that wait in pop
+    size_t waiting_pops;
+    /// amount of threads, that wait in push
+    size_t waiting_pushes;
+};
+
+/************************************************************//**
+ * @brief Creates blocking stack
+ *
+ * @param[in] bstk stack pointer
+ * @param[in] max_size maximum amount of elements (UNBOUNDED for no limit)
+ * @param[in] capacity stack capacity
+ * @return int error code
+ ************************************************************/
+int BlockingStackCtor(BlockingStack* bstk, size_t max_size = UNBOUNDED, size_t capacity = DEFAULT_CAPACITY);
+
+/************************************************************//**
+ * @brief Destroys blocking stack (no thread may wait on it)
+ *
+ * @param[in] bstk stack pointer
+ * @return int error code
+ ************************************************************/
+int BlockingStackDtor(BlockingStack* bstk);
+
+/************************************************************//**
+ * @brief Pushes element, waits while stack is full
+ *
+ * @param[in] bstk stack pointer
+ * @param[in] value element
+ * @return int error code
+ ************************************************************/
+int BlockingStackPush(BlockingStack* bstk, elem_t value);
+
+/************************************************************//**
+ * @brief Pushes element, if stack is not full
+ *
+ * @param[in] bstk stack pointer
+ * @param[in] value element
+ * @return int error code (ERRORS::WOULD_BLOCK, if stack is full)
+ ************************************************************/
+int BlockingStackTryPush(BlockingStack* bstk, elem_t value);
+
+/************************************************************//**
+ * @brief Pushes element, waits while stack is full, but not longer than timeout
+ *
+ * @param[in] bstk stack pointer
+ * @param[in] value element
+ * @param[in] timeout_us timeout in microseconds
+ * @return int error code (ERRORS::TIMED_OUT, if stack was full whole timeout)
+ ************************************************************/
+int BlockingStackTimedPush(BlockingStack* bstk, elem_t value, size_t timeout_us);
+
+/************************************************************//**
+ * @brief Pops element, waits while stack is empty
+ *
+ * @param[in] bstk stack pointer
+ * @param[out] ret_value popped element
+ * @return int error code
+ ************************************************************/
+int BlockingStackPop(BlockingStack* bstk, elem_t* ret_value);
+
+/************************************************************//**
+ * @brief Pops element, if stack is not empty
+ *
+ * @param[in] bstk stack pointer
+ * @param[out] ret_value popped element
+ * @return int error code (ERRORS::WOULD_BLOCK, if stack is empty)
+ ************************************************************/
+int BlockingStackTryPop(BlockingStack* bstk, elem_t* ret_value);
+
+/************************************************************//**
+ * @brief Pops element, waits while stack is empty, but not longer than timeout
+ *
+ * @param[in] bstk stack pointer
+ * @param[out] ret_value popped element
+ * @param[in] timeout_us timeout in microseconds
+ * @return int error code (ERRORS::TIMED_OUT, if stack was empty whole timeout)
+ ************************************************************/
+int BlockingStackTimedPop(BlockingStack* bstk, elem_t* ret_value, size_t timeout_us);
+
+/************************************************************//**
+ * @brief Prints info about blocking stack in output stream
+ *
+ * @param[in] fp output stream
+ * @param[in] bstk stack pointer
+ * @param[in] func function, where print called
+ * @param[in] file file, where print called
+ * @param[in] line line, where print caled
+ * @return int error code
+ ************************************************************/
+int BlockingStackDump(FILE* fp, const void* bstk, const char* func, const char* file, const int line);
+
+#endif
@@ -0,0 +1,617 @@
+#include <stdlib.h>
+#include <assert.h>
+
+#include "concurrent_stack.h"
+#include "log_funcs.h"
+
+// ============= STATIC FUNCS ===============
+static inline uint64_t MakeTagged(const uint32_t index, const uint32_t tag);
+static inline uint32_t TaggedIndex(const uint64_t tagged);
+static inline uint32_t TaggedTag(const uint64_t tagged);
+
+static inline ConcurrentNode* GetNode(const ConcurrentStack* stk, const uint32_t index);
+static uint32_t AllocNode(ConcurrentStack* stk);
+static void FreeNode(ConcurrentStack* stk, const uint32_t index);
+static bool AllocChunk(ConcurrentStack* stk, const size_t chunk);
+
+static inline void InitNodeCanary(ConcurrentNode* node);
+static inline bool VerifyNodeCanary(const ConcurrentNode* node);
+static int ReportCorruption(ConcurrentStack* stk, const int condition,
+                            const char* func, const char* file, const int line);
+
+static bool TryEliminatePush(ConcurrentStack* stk, const uint32_t index);
+static uint32_t TryEliminatePop(ConcurrentStack* stk);
+static inline size_t RandomSlot();
+static inline void Backoff(size_t* spins);
+static inline void CpuRelax();
+
+static size_t CountList(const ConcurrentStack* stk, uint32_t index, const uint32_t max_count);
+static void PrintConcurrentStackCondition(const ConcurrentStack* stk);
+//============================================
+
+#ifdef REPORT_CORRUPTION
+#undef REPORT_CORRUPTION
+
+#endif
+#define REPORT_CORRUPTION(stk, condition)   ReportCorruption(stk, condition, __func__, __FILE__, __LINE__)
+
+// =============CONSTS============
+static const canary_t canary_val = STACK_CANARY;
+static const elem_t POISON       = STACK_POISON;
+// ===============================
+
+int ConcurrentStackCtor(ConcurrentStack* stk)
+{
+    assert(stk);
+
+    ON_CANARY
+    (
+        stk->stack_prefix  = canary_val;
+        stk->stack_postfix = canary_val
+    );
+
+    for (size_t i = 0; i < CONCURRENT_MAX_CHUNKS; i++)
+        stk->chunks[i].store(nullptr, std::memory_order_relaxed);
+
+    for (size_t i = 0; i < ELIMINATION_SLOTS; i++)
+        stk->elimination[i].offer.store(MakeTagged(CONCURRENT_NIL, 0), std::memory_order_relaxed);
+
+    stk->status.store(OK, std::memory_order_relaxed);
+    stk->top.store(MakeTagged(CONCURRENT_NIL, 0), std::memory_order_relaxed);
+    stk->free_top.store(MakeTagged(CONCURRENT_NIL, 0), std::memory_order_relaxed);
+    stk->node_count.store(0, std::memory_order_relaxed);
+
+    if (!AllocChunk(stk, 0))
+        return (int) ERRORS::ALLOCATE_MEMORY;
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int ConcurrentStackDtor(ConcurrentStack* stk)
+{
+    assert(stk);
+
+    for (size_t i = 0; i < CONCURRENT_MAX_CHUNKS; i++)
+    {
+        free(stk->chunks[i].load(std::memory_order_acquire));
+        stk->chunks[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    stk->top.store(MakeTagged(CONCURRENT_NIL, 0), std::memory_order_relaxed);
+    stk->free_top.store(MakeTagged(CONCURRENT_NIL, 0), std::memory_order_relaxed);
+    stk->node_count.store(0, std::memory_order_relaxed);
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int ConcurrentStackPush(ConcurrentStack* stk, elem_t value)
+{
+    assert(stk);
+
+    uint32_t index = AllocNode(stk);
+
+    if (index == CONCURRENT_NIL)
+        return (int) ERRORS::ALLOCATE_MEMORY;
+
+    ConcurrentNode* node = GetNode(stk, index);
+
+    ON_CANARY
+    (
+        if (!VerifyNodeCanary(node)) return REPORT_CORRUPTION(stk, DATA_CANARY_TRIGGER)
+    );
+
+    // free node was written by somebody, who did not own it
+    if (node->value != POISON)
+        return REPORT_CORRUPTION(stk, POISON_ACCESS);
+
+    node->value = value;
+
+    size_t   spins = 1;
+    uint64_t top   = stk->top.load(std::memory_order_relaxed);
+
+    while (true)
+    {
+        node->next.store(TaggedIndex(top), std::memory_order_relaxed);
+
+        if (stk->top.compare_exchange_weak(top, MakeTagged(index, TaggedTag(top) + 1),
+                                           std::memory_order_release, std::memory_order_relaxed))
+            return (int) ERRORS::NONE;
+
+        if (TryEliminatePush(stk, index))
+            return (int) ERRORS::NONE;
+
+        Backoff(&spins);
+        top = stk->top.load(std::memory_order_relaxed);
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int ConcurrentStackPop(ConcurrentStack* stk, elem_t* ret_value)
+{
+    assert(stk);
+    assert(ret_value);
+
+    size_t   spins = 1;
+    uint32_t index = CONCURRENT_NIL;
+    uint64_t top   = stk->top.load(std::memory_order_acquire);
+
+    while (true)
+    {
+        index = TaggedIndex(top);
+
+        if (index == CONCURRENT_NIL)
+            return (int) ERRORS::EMPTY_STACK;
+
+        // node may be popped and reused by other thread, than CAS fails because of tag
+        uint32_t next = GetNode(stk, index)->next.load(std::memory_order_relaxed);
+
+        if (stk->top.compare_exchange_weak(top, MakeTagged(next, TaggedTag(top) + 1),
+                                           std::memory_order_acquire, std::memory_order_acquire))
+            break;
+
+        index = TryEliminatePop(stk);
+        if (index != CONCURRENT_NIL)
+            break;
+
+        Backoff(&spins);
+        top = stk->top.load(std::memory_order_acquire);
+    }
+
+    ConcurrentNode* node = GetNode(stk, index);
+
+    ON_CANARY
+    (
+        if (!VerifyNodeCanary(node)) return REPORT_CORRUPTION(stk, DATA_CANARY_TRIGGER)
+    );
+
+    *(ret_value) = node->value;
+    node->value  = POISON;
+
+    FreeNode(stk, index);
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int ConcurrentStackDump(FILE* fp, const void* stack, const char* func, const char* file, const int line)
+{
+    assert(stack);
+    assert(func);
+    assert(file);
+
+    const ConcurrentStack* stk = (const ConcurrentStack*) stack;
+
+    uint64_t top        = stk->top.load(std::memory_order_acquire);
+    uint64_t free_top   = stk->free_top.load(std::memory_order_acquire);
+    uint32_t node_count = stk->node_count.load(std::memory_order_acquire);
+
+    LOG_START_MOD(func, file, line);
+
+    fprintf(fp, "ConcurrentStack      > [%p]\n"
+                "top                  > %u (tag %u)\n"
+                "free top             > %u (tag %u)\n"
+                "nodes                > %u\n"
+                "size                 > %zu\n",
+                stk, TaggedIndex(top), TaggedTag(top), TaggedIndex(free_top), TaggedTag(free_top),
+                node_count, CountList(stk, TaggedIndex(top), node_count));
+
+    ON_CANARY
+    (
+        fprintf(fp, "STACK PREFIX CANARY  > %llX\n"
+                    "STACK POSTFIX CANARY > %llX\n",
+                    stk->stack_prefix, stk->stack_postfix)
+    );
+
+    fprintf(fp, "ELEMENTS: \n\n");
+
+    // list is walked without synchronization, so other threads must not use stack
+    uint32_t index = TaggedIndex(top);
+    for (uint32_t i = 0; i < node_count && index < node_count; i++)
+    {
+        const ConcurrentNode* node = GetNode(stk, index);
+
+        if (node == nullptr)
+            break;
+
+        fprintf(fp, "[%u] " PRINT_ELEM_T "\n", index, node->value);
+
+        index = node->next.load(std::memory_order_relaxed);
+    }
+
+    if (stk->status.load(std::memory_order_relaxed) != OK)
+        PrintConcurrentStackCondition(stk);
+
+    LOG_END();
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int ConcurrentStackOk(const ConcurrentStack* stack)
+{
+    assert(stack);
+
+#pragma GCC diagnostic ignored "-Wcast-qual"
+    ConcurrentStack* stk = (ConcurrentStack*) stack;
+#pragma GCC diagnostic warning "-Wcast-qual"
+
+    int condition = OK;
+
+    ON_CANARY
+    (
+        if (stk->stack_prefix != canary_val || stk->stack_postfix != canary_val) condition |= STACK_CANARY_TRIGGER
+    );
+
+    uint32_t node_count = stk->node_count.load(std::memory_order_acquire);
+
+    for (uint32_t index = 0; index < node_count; index++)
+    {
+        const ConcurrentNode* node = GetNode(stk, index);
+
+        if (node == nullptr)
+        {
+            condition |= INVALID_DATA;
+            break;
+        }
+
+        ON_CANARY
+        (
+            if (!VerifyNodeCanary(node)) condition |= DATA_CANARY_TRIGGER
+        );
+    }
+
+    if (condition == OK)
+    {
+        uint32_t index = TaggedIndex(stk->free_top.load(std::memory_order_acquire));
+        size_t   count = 0;
+
+        for (; index != CONCURRENT_NIL && index < node_count && count <= node_count; count++)
+        {
+            const ConcurrentNode* node = GetNode(stk, index);
+
+            if (node->value != POISON)
+                condition |= POISON_ACCESS;
+
+            index = node->next.load(std::memory_order_relaxed);
+        }
+
+        size_t size = CountList(stk, TaggedIndex(stk->top.load(std::memory_order_acquire)), node_count);
+
+        // lists must end with CONCURRENT_NIL and can not share nodes
+        if (index != CONCURRENT_NIL || size == SIZE_MAX || count + size > node_count)
+            condition |= INVALID_SIZE;
+    }
+
+    stk->status.fetch_or(condition, std::memory_order_relaxed);
+
+    return stk->status.load(std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline uint64_t MakeTagged(const uint32_t index, const uint32_t tag)
+{
+    return ((uint64_t) tag << 32) | index;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline uint32_t TaggedIndex(const uint64_t tagged)
+{
+    return (uint32_t) tagged;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline uint32_t TaggedTag(const uint64_t tagged)
+{
+    return (uint32_t) (tagged >> 32);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline ConcurrentNode* GetNode(const ConcurrentStack* stk, const uint32_t index)
+{
+    assert(stk);
+    assert(index != CONCURRENT_NIL);
+
+    // chunk i starts with index CONCURRENT_FIRST_CHUNK * (2^i - 1)
+    uint64_t scaled = (uint64_t) index / CONCURRENT_FIRST_CHUNK + 1;
+    size_t   chunk  = (size_t) (63 - __builtin_clzll(scaled));
+    uint64_t first  = (uint64_t) CONCURRENT_FIRST_CHUNK * ((1ULL << chunk) - 1);
+
+    ConcurrentNode* nodes = stk->chunks[chunk].load(std::memory_order_acquire);
+
+    if (nodes == nullptr)
+        return nullptr;
+
+    return nodes + (index - first);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static uint32_t AllocNode(ConcurrentStack* stk)
+{
+    assert(stk);
+
+    size_t   spins    = 1;
+    uint64_t free_top = stk->free_top.load(std::memory_order_acquire);
+
+    while (TaggedIndex(free_top) != CONCURRENT_NIL)
+    {
+        uint32_t index = TaggedIndex(free_top);
+        uint32_t next  = GetNode(stk, index)->next.load(std::memory_order_relaxed);
+
+        if (stk->free_top.compare_exchange_weak(free_top, MakeTagged(next, TaggedTag(free_top) + 1),
+                                                std::memory_order_acquire, std::memory_order_acquire))
+            return index;
+
+        Backoff(&spins);
+    }
+
+    uint32_t index = stk->node_count.fetch_add(1, std::memory_order_relaxed);
+    uint64_t last  = (uint64_t) CONCURRENT_FIRST_CHUNK * ((1ULL << CONCURRENT_MAX_CHUNKS) - 1);
+
+    if ((uint64_t) index >= last)
+    {
+        stk->node_count.fetch_sub(1, std::memory_order_relaxed);
+        return CONCURRENT_NIL;
+    }
+
+    size_t chunk = (size_t) (63 - __builtin_clzll((uint64_t) index / CONCURRENT_FIRST_CHUNK + 1));
+
+    if (stk->chunks[chunk].load(std::memory_order_acquire) == nullptr && !AllocChunk(stk, chunk))
+    {
+        uint32_t reserved = index + 1;
+
+        // node is given back, if it is the last one, otherwise nodes are cut after it, and it stays without memory
+        if (!stk->node_count.compare_exchange_strong(reserved, index, std::memory_order_relaxed))
+            stk->status.fetch_or(INVALID_DATA, std::memory_order_relaxed);
+
+        return CONCURRENT_NIL;
+    }
+
+    ConcurrentNode* node = GetNode(stk, index);
+
+    InitNodeCanary(node);
+    node->value = POISON;
+    node->next.store(CONCURRENT_NIL, std::memory_order_relaxed);
+
+    return index;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void FreeNode(ConcurrentStack* stk, const uint32_t index)
+{
+    assert(stk);
+
+    ConcurrentNode* node = GetNode(stk, index);
+
+    size_t   spins    = 1;
+    uint64_t free_top = stk->free_top.load(std::memory_order_relaxed);
+
+    while (true)
+    {
+        node->next.store(TaggedIndex(free_top), std::memory_order_relaxed);
+
+        if (stk->free_top.compare_exchange_weak(free_top, MakeTagged(index, TaggedTag(free_top) + 1),
+                                                std::memory_order_release, std::memory_order_relaxed))
+            return;
+
+        Backoff(&spins);
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static bool AllocChunk(ConcurrentStack* stk, const size_t chunk)
+{
+    assert(stk);
+    assert(chunk < CONCURRENT_MAX_CHUNKS);
+
+    ConcurrentNode* nodes = (ConcurrentNode*) calloc((size_t) CONCURRENT_FIRST_CHUNK << chunk,
+                                                     sizeof(ConcurrentNode));
+
+    if (nodes == nullptr)
+        return false;
+
+    ConcurrentNode* expected = nullptr;
+
+    // other thread could publish this chunk first
+    if (!stk->chunks[chunk].compare_exchange_strong(expected, nodes, std::memory_order_acq_rel))
+        free(nodes);
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline void InitNodeCanary(ConcurrentNode* node)
+{
+    assert(node);
+
+    ON_CANARY
+    (
+        node->prefix  = canary_val;
+        node->postfix = canary_val
+    );
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline bool VerifyNodeCanary(const ConcurrentNode* node)
+{
+    assert(node);
+
+    ON_CANARY
+    (
+        return node->prefix == canary_val && node->postfix == canary_val
+    );
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static int ReportCorruption(ConcurrentStack* stk, const int condition,
+                            const char* func, const char* file, const int line)
+{
+    assert(stk);
+
+    stk->status.fetch_or(condition, std::memory_order_relaxed);
+
+    LogDump(ConcurrentStackDump, stk, func, file, line);
+
+    return (int) ERRORS::INVALID_STACK;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static bool TryEliminatePush(ConcurrentStack* stk, const uint32_t index)
+{
+    assert(stk);
+
+    std::atomic<uint64_t>* slot = &stk->elimination[RandomSlot()].offer;
+    uint64_t empty = slot->load(std::memory_order_relaxed);
+
+    if (TaggedIndex(empty) != CONCURRENT_NIL)
+        return false;
+
+    uint64_t offer = MakeTagged(index, TaggedTag(empty) + 1);
+
+    if (!slot->compare_exchange_strong(empty, offer, std::memory_order_release, std::memory_order_relaxed))
+        return false;
+
+    for (size_t i = 0; i < ELIMINATION_SPINS; i++)
+    {
+        if (slot->load(std::memory_order_relaxed) != offer)
+            return true;
+
+        CpuRelax();
+    }
+
+    // offer is withdrawn, if nobody took it
+    return !slot->compare_exchange_strong(offer, MakeTagged(CONCURRENT_NIL, TaggedTag(offer) + 1),
+                                          std::memory_order_relaxed, std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static uint32_t TryEliminatePop(ConcurrentStack* stk)
+{
+    assert(stk);
+
+    std::atomic<uint64_t>* slot = &stk->elimination[RandomSlot()].offer;
+    uint64_t offer = slot->load(std::memory_order_acquire);
+
+    if (TaggedIndex(offer) == CONCURRENT_NIL)
+        return CONCURRENT_NIL;
+
+    if (!slot->compare_exchange_strong(offer, MakeTagged(CONCURRENT_NIL, TaggedTag(offer) + 1),
+                                       std::memory_order_acquire, std::memory_order_relaxed))
+        return CONCURRENT_NIL;
+
+    return TaggedIndex(offer);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline size_t RandomSlot()
+{
+    // xorshift, seeded by address of thread local state
+    static thread_local uint32_t state = 0;
+
+    if (state == 0)
+        state = (uint32_t) (uintptr_t) &state | 1;
+
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+
+    return state % ELIMINATION_SLOTS;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline void Backoff(size_t* spins)
+{
+    assert(spins);
+
+    for (size_t i = 0; i < *spins; i++)
+        CpuRelax();
+
+    if (*spins < MAX_BACKOFF_SPINS)
+        *spins *= 2;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static size_t CountList(const ConcurrentStack* stk, uint32_t index, const uint32_t max_count)
+{
+    assert(stk);
+
+    size_t count = 0;
+
+    for (; index != CONCURRENT_NIL; count++)
+    {
+        // cycle or index, that was never allocated
+        if (count >= max_count || index >= max_count)
+            return SIZE_MAX;
+
+        const ConcurrentNode* node = GetNode(stk, index);
+
+        if (node == nullptr)
+            return SIZE_MAX;
+
+        index = node->next.load(std::memory_order_relaxed);
+    }
+
+    return count;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void PrintConcurrentStackCondition(const ConcurrentStack* stk)
+{
+    assert(stk);
+
+    int status = stk->status.load(std::memory_order_relaxed);
+
+    PrintLog("\n>>>>>>>>>>STACK CONDITIONS<<<<<<<<<\n");
+
+    if ((status & INVALID_SIZE) != 0)
+        PrintLog("BROKEN NODE LIST\n");
+
+    if ((status & INVALID_DATA) != 0)
+        PrintLog("NODE CHUNK IS MISSING\n");
+
+    if ((status & POISON_ACCESS) != 0)
+        PrintLog("FREE NODE WAS WRITTEN\n");
+
+    if ((status & DATA_CANARY_TRIGGER) != 0)
+        PrintLog("NODE CANARY TRIGGERED\n");
+
+    if ((status & STACK_CANARY_TRIGGER) != 0)
+        PrintLog("STACK CANARY TRIGGERED\n");
+
+    PrintLog(">>>>>>>>STACK CONDITIONS END<<<<<<<\n\n");
+}
@@ -0,0 +1,150 @@
+#ifndef __CONCURRENT_STACK_H_
+#define __CONCURRENT_STACK_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+
+#include "stack.h"
+
+/*! \file
+* \brief Contains lock-free stack, that can be shared by many threads
+*
+* Treiber stack of nodes, that are addressed by 32-bit indices. Top of stack and top of free node list
+* are tagged words (tag in high half, index in low half), tag is incremented by every successful CAS,
+* so popper with stale top can not succeed (ABA protection). Nodes are never freed before ConcurrentStackDtor,
+* popped nodes go to free list, so reading next of node, that was popped by other thread, is safe.
+* Push and pop, which lost CAS, try to meet each other in elimination array before backing off.
+*/
+
+/// amount of nodes in first node chunk (every next chunk is twice bigger)
+static const uint32_t CONCURRENT_FIRST_CHUNK = 1024;
+/// maximum amount of node chunks (CONCURRENT_FIRST_CHUNK * (2^22 - 1) indices fit in 32 bits)
+static const size_t CONCURRENT_MAX_CHUNKS = 22;
+/// index of no node
+static const uint32_t CONCURRENT_NIL = UINT32_MAX;
+
+/// amount of elimination slots
+static const size_t ELIMINATION_SLOTS = 16;
+/// amount of spins, that push waits in elimination slot for pop
+static const size_t ELIMINATION_SPINS = 128;
+/// maximum amount of spins, that operation waits after lost CAS
+static const size_t MAX_BACKOFF_SPINS = 1024;
+
+/// @brief node of concurrent stack
+struct ConcurrentNode
+{
+    ON_CANARY
+    (
+        /// node prefix canary
+        canary_t prefix;
+    )
+
+    /// element (POISON, while node is free)
+    elem_t value;
+    /// index of next node
+    std::atomic<uint32_t> next;
+
+    ON_CANARY
+    (
+        /// node postfix canary
+        canary_t postfix;
+    )
+};
+
+/// @brief elimination slot (tagged index of node, that push offers to pop, or CONCURRENT_NIL)
+struct alignas(CACHE_LINE_SIZE) EliminationSlot
+{
+    /// offered node
+    std::atomic<uint64_t> offer;
+};
+
+/// @brief lock-free stack
+struct ConcurrentStack
+{
+    ON_CANARY
+    (
+        /// stack prefix canary
+        canary_t stack_prefix;
+    )
+
+    /// node chunks (chunk i holds CONCURRENT_FIRST_CHUNK << i nodes)
+    std::atomic<ConcurrentNode*> chunks[CONCURRENT_MAX_CHUNKS];
+    /// stack status (0 if everything is fine)
+    std::atomic<int> status;
+
+    /// tagged index of top node
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> top;
+    /// tagged index of first free node
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> free_top;
+    /// amount of nodes, that were cut from chunks
+    alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> node_count;
+
+    /// elimination array
+    EliminationSlot elimination[ELIMINATION_SLOTS];
+
+    ON_CANARY
+    (
+        /// stack postfix canary
+        canary_t stack_postfix;
+    )
+};
+
+/************************************************************//**
+ * @brief Creates concurrent stack (must not be shared before call)
+ *
+ * @param[in] stk stack pointer
+ * @return int error code
+ ************************************************************/
+int ConcurrentStackCtor(ConcurrentStack* stk);
+
+/************************************************************//**
+ * @brief Destroys concurrent stack (no other thread may use it)
+ *
+ * @param[in] stk stack pointer
+ * @return int error code
+ ************************************************************/
+int ConcurrentStackDtor(ConcurrentStack* stk);
+
+/************************************************************//**
+ * @brief Pushes element in stack (lock-free, any thread)
+ *
+ * @param[in] stk stack pointer
+ * @param[in] value element
+ * @return int error code
+ ************************************************************/
+int ConcurrentStackPush(ConcurrentStack* stk, elem_t value);
+
+/************************************************************//**
+ * @brief Pops element from stack (lock-free, any thread)
+ *
+ * @param[in] stk stack pointer
+ * @param[out] ret_value popped element
+ * @return int error code (ERRORS::EMPTY_STACK, if stack is empty)
+ ************************************************************/
+int ConcurrentStackPop(ConcurrentStack* stk, elem_t* ret_value);
+
+/************************************************************//**
+ * @brief Prints info about concurrent stack in output stream
+ *
+ * Node list is walked without synchronization, so it is consistent only, if no other thread uses stack
+ *
+ * @param[in] fp output stream
+ * @param[in] stk stack pointer
+ * @param[in] func function, where print called
+ * @param[in] file file, where print called
+ * @param[in] line line, where print caled
+ * @return int error code
+ ************************************************************/
+int ConcurrentStackDump(FILE* fp, const void* stk, const char* func, const char* file, const int line);
+
+/************************************************************//**
+ * @brief Verifies canaries of stack and all nodes, poison of free nodes and node lists
+ * (no other thread may use stack)
+ *
+ * @param[in] stk stack pointer
+ * @return int stack condition code
+ ************************************************************/
+int ConcurrentStackOk(const ConcurrentStack* stk);
+
+#endif
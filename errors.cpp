@@ -50,6 +50,26 @@ int PrintError(FILE* fp, const void* err, const char* func, const char* file, co
             LOG_END();
             return (int) error->code;
 
+        case (ERRORS::EMPTY_STACK):
+            fprintf(fp, "EMPTY STACK ERROR\n");
+            LOG_END();
+            return (int) error->code;
+
+        case (ERRORS::FULL_STACK):
+            fprintf(fp, "FULL STACK ERROR\n");
+            LOG_END();
+            return (int) error->code;
+
+        case (ERRORS::WOULD_BLOCK):
+            fprintf(fp, "WOULD BLOCK ERROR\n");
+            LOG_END();
+            return (int) error->code;
+
+        case (ERRORS::TIMED_OUT):
+            fprintf(fp, "TIMED OUT ERROR\n");
+            LOG_END();
+            return (int) error->code;
+
         case (ERRORS::UNKNOWN):
         default:
             fprintf(fp, "UNKNOWN ERROR\n");
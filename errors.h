@@ -39,6 +39,14 @@ enum class ERRORS
 
     /// invalid stack error
     INVALID_STACK,
+    /// pop from empty stack
+    EMPTY_STACK,
+    /// push to full stack of fixed capacity
+    FULL_STACK,
+    /// operation could not be done without waiting
+    WOULD_BLOCK,
+    /// operation could not be done before timeout
+    TIMED_OUT,
 
     /// unknown error
     UNKNOWN
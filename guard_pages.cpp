@@ -0,0 +1,227 @@
+#include <string.h>
+#include <assert.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <atomic>
+#include <mutex>
+
+#include "guard_pages.h"
+#include "stack.h"
+#include "log_funcs.h"
+
+/// @brief stack buffer, whose guard pages are watched by SIGSEGV handler
+struct WatchedBuffer
+{
+    /// stack (nullptr, if slot is free)
+    std::atomic<const Stack_t*> owner;
+    /// buffer
+    std::atomic<const char*> begin;
+    /// buffer size
+    std::atomic<size_t> size;
+};
+
+static WatchedBuffer WATCHED[GUARD_MAX_WATCHED] = {};
+
+/// lock of watch slots and handler installation (handler itself only reads slots)
+static std::mutex WATCH_LOCK;
+
+/// SIGSEGV action, that was before guard handler
+static struct sigaction PREV_ACTION = {};
+static bool HANDLER_INSTALLED = false;
+
+// ============= STATIC FUNCS ===============
+static void* GuardAlloc(void* ctx, size_t size);
+static void* GuardRealloc(void* ctx, void* ptr, size_t old_size, size_t new_size);
+static void  GuardFree(void* ctx, void* ptr, size_t size);
+
+static void GuardHandler(int sig, siginfo_t* info, void* context);
+static const Stack_t* FindOwner(const char* address);
+static inline size_t GetPageSize();
+//============================================
+
+const StackAllocator GUARD_ALLOCATOR = {GuardAlloc, GuardRealloc, GuardFree, nullptr};
+
+//-----------------------------------------------------------------------------------------------------
+
+size_t GuardPagesRound(size_t size)
+{
+    size_t page_size = GetPageSize();
+
+    return (size + page_size - 1) & ~(page_size - 1);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int GuardPagesWatch(const Stack_t* stk, const void* ptr, size_t size)
+{
+    assert(stk);
+    assert(ptr);
+
+    std::lock_guard<std::mutex> guard(WATCH_LOCK);
+
+    if (!HANDLER_INSTALLED)
+    {
+        struct sigaction action = {};
+
+        action.sa_sigaction = GuardHandler;
+        action.sa_flags     = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+
+        if (sigaction(SIGSEGV, &action, &PREV_ACTION) != 0)
+            return (int) ERRORS::UNKNOWN;
+
+        HANDLER_INSTALLED = true;
+    }
+
+    WatchedBuffer* free_slot = nullptr;
+
+    for (size_t i = 0; i < GUARD_MAX_WATCHED; i++)
+    {
+        const Stack_t* owner = WATCHED[i].owner.load(std::memory_order_relaxed);
+
+        if (owner == stk || (owner == nullptr && free_slot == nullptr))
+            free_slot = &WATCHED[i];
+
+        if (owner == stk)
+            break;
+    }
+
+    if (free_slot == nullptr)
+        return (int) ERRORS::ALLOCATE_MEMORY;
+
+    // slot is hidden from handler, while it is rewritten
+    free_slot->owner.store(nullptr, std::memory_order_release);
+    free_slot->begin.store((const char*) ptr, std::memory_order_relaxed);
+    free_slot->size.store(size, std::memory_order_relaxed);
+    free_slot->owner.store(stk, std::memory_order_release);
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void GuardPagesUnwatch(const Stack_t* stk)
+{
+    assert(stk);
+
+    std::lock_guard<std::mutex> guard(WATCH_LOCK);
+
+    for (size_t i = 0; i < GUARD_MAX_WATCHED; i++)
+    {
+        if (WATCHED[i].owner.load(std::memory_order_relaxed) == stk)
+            WATCHED[i].owner.store(nullptr, std::memory_order_release);
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void* GuardAlloc(void* /* ctx */, size_t size)
+{
+    size_t page_size = GetPageSize();
+
+    assert(size % page_size == 0);
+
+    void* region = mmap(nullptr, size + 2 * page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (region == MAP_FAILED)
+        return nullptr;
+
+    char* buffer = (char*) region + page_size;
+
+    if (mprotect(region, page_size, PROT_NONE) != 0 || mprotect(buffer + size, page_size, PROT_NONE) != 0)
+    {
+        munmap(region, size + 2 * page_size);
+        return nullptr;
+    }
+
+    return buffer;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void* GuardRealloc(void* ctx, void* ptr, size_t old_size, size_t new_size)
+{
+    assert(ptr);
+
+    void* new_ptr = GuardAlloc(ctx, new_size);
+
+    if (new_ptr == nullptr)
+        return nullptr;
+
+    memcpy(new_ptr, ptr, (old_size < new_size) ? old_size : new_size);
+
+    GuardFree(ctx, ptr, old_size);
+
+    return new_ptr;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void GuardFree(void* /* ctx */, void* ptr, size_t size)
+{
+    if (ptr == nullptr)
+        return;
+
+    size_t page_size = GetPageSize();
+
+    munmap((char*) ptr - page_size, size + 2 * page_size);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void GuardHandler(int /* sig */, siginfo_t* info, void* /* context */)
+{
+    const char* address  = (const char*) info->si_addr;
+    const Stack_t* owner = FindOwner(address);
+
+    if (owner != nullptr)
+    {
+        // handler reports from faulting thread, so dump is written as usual (log is not async-signal-safe,
+        // but process is about to die anyway)
+#pragma GCC diagnostic ignored "-Wcast-qual"
+        Stack_t* stk = (Stack_t*) owner;
+#pragma GCC diagnostic warning "-Wcast-qual"
+
+        stk->status |= DATA_CANARY_TRIGGER;
+
+        PrintLog("GUARD PAGE OF STACK [%p] IS ACCESSED AT [%p]\n", stk, address);
+        LogDump(StackDump, stk, __func__, __FILE__, __LINE__);
+        FlushLog();
+    }
+
+    // faulting instruction is run again and its fault goes to previous action
+    sigaction(SIGSEGV, &PREV_ACTION, nullptr);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static const Stack_t* FindOwner(const char* address)
+{
+    size_t page_size = GetPageSize();
+
+    for (size_t i = 0; i < GUARD_MAX_WATCHED; i++)
+    {
+        const Stack_t* owner = WATCHED[i].owner.load(std::memory_order_acquire);
+
+        if (owner == nullptr)
+            continue;
+
+        const char* begin = WATCHED[i].begin.load(std::memory_order_relaxed);
+        const char* end   = begin + WATCHED[i].size.load(std::memory_order_relaxed);
+
+        if ((address >= begin - page_size && address < begin) || (address >= end && address < end + page_size))
+            return owner;
+    }
+
+    return nullptr;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline size_t GetPageSize()
+{
+    static const size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+
+    return page_size;
+}
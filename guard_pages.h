@@ -0,0 +1,48 @@
+#ifndef __GUARD_PAGES_H_
+#define __GUARD_PAGES_H_
+
+#include <stdio.h>
+
+#include "types.h"
+#include "allocator.h"
+
+/*! \file
+* \brief Contains guarded buffers: every buffer is surrounded by inaccessible (mprotect) pages
+*
+* Buffer takes whole pages, so access right before or right after it faults at once. Buffers of stacks are watched:
+* SIGSEGV handler finds stack, whose guard page was hit, marks it with DATA_CANARY_TRIGGER and dumps it,
+* then fault goes to previous handler (default one kills program).
+*/
+
+/// allocator of guarded buffers (buffer size must be multiple of page size, GuardPagesRound gives it)
+extern const StackAllocator GUARD_ALLOCATOR;
+
+/// amount of buffers, that can be watched at once
+static const size_t GUARD_MAX_WATCHED = 256;
+
+/************************************************************//**
+ * @brief Rounds size up to whole pages
+ *
+ * @param[in] size size in bytes
+ * @return size_t rounded size
+ ************************************************************/
+size_t GuardPagesRound(size_t size);
+
+/************************************************************//**
+ * @brief Makes SIGSEGV handler report faults in guard pages of stack buffer (handler is installed by first call)
+ *
+ * @param[in] stk stack, that owns buffer
+ * @param[in] ptr buffer
+ * @param[in] size buffer size
+ * @return int error code
+ ************************************************************/
+int GuardPagesWatch(const Stack_t* stk, const void* ptr, size_t size);
+
+/************************************************************//**
+ * @brief Stops watching guard pages of stack buffer
+ *
+ * @param[in] stk stack, that owns buffer
+ ************************************************************/
+void GuardPagesUnwatch(const Stack_t* stk);
+
+#endif
@@ -1,51 +1,252 @@
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include "hash.h"
 
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define HASH_X86_64 1
+
+#else
+#define HASH_X86_64 0
+#endif
+
+// ============= STATIC FUNCS ===============
+static hash_t Crc32cTable(const void* obj, size_t size);
+static const unsigned int* GetCrc32cTable();
+
+#if HASH_X86_64
+static hash_t Crc32cSse42(const void* obj, size_t size);
+#endif
+
+static inline unsigned long long XxRound(unsigned long long acc, unsigned long long input);
+static inline unsigned long long XxMergeRound(unsigned long long acc, unsigned long long lane);
+static inline unsigned long long XxRotl(unsigned long long x, int r);
+static inline unsigned long long XxRead64(const unsigned char* data);
+static inline unsigned int XxRead32(const unsigned char* data);
+//============================================
+
+// =============CONSTS============
+static const unsigned int CRC32C_POLY = 0x82F63B78;
+
+static const unsigned long long XX_PRIME_1 = 0x9E3779B185EBCA87ULL;
+static const unsigned long long XX_PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+static const unsigned long long XX_PRIME_3 = 0x165667B19E3779F9ULL;
+static const unsigned long long XX_PRIME_4 = 0x85EBCA77C2B2AE63ULL;
+static const unsigned long long XX_PRIME_5 = 0x27D4EB2F165667C5ULL;
+// ===============================
+
 hash_t MurmurHash (const void* obj, size_t size)
+{
+    return MurmurHashInline(obj, size);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+hash_t Crc32cHash (const void* obj, size_t size)
 {
     assert(obj);
 
-    const unsigned char* data = (const unsigned char*) obj;
-    const hash_t seed = 0;
-    const hash_t m    = 0x5bd1e995;
-    const int    r    = 24;
-    hash_t       k    = 0;
+#if HASH_X86_64
+    static const hash_f crc32c = __builtin_cpu_supports("sse4.2") ? Crc32cSse42 : Crc32cTable;
+#else
+    static const hash_f crc32c = Crc32cTable;
+#endif
+
+    return crc32c(obj, size);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+hash_t XxHash (const void* obj, size_t size)
+{
+    unsigned long long hash = XxHash64(obj, size, 0);
 
-    hash_t hash = (hash_t) (seed ^ size);
+    return (hash_t) (hash ^ (hash >> 32));
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+unsigned long long XxHash64 (const void* obj, size_t size, unsigned long long seed)
+{
+    assert(obj);
 
-    while (size >= 4)
+    const unsigned char* data = (const unsigned char*) obj;
+    const unsigned char* end  = data + size;
+    unsigned long long   hash = 0;
+
+    if (size >= 32)
     {
-        k  = data[0];
-        k |= data[1] << 8;
-        k |= data[2] << 16;
-        k |= data[3] << 24;
+        unsigned long long lane_1 = seed + XX_PRIME_1 + XX_PRIME_2;
+        unsigned long long lane_2 = seed + XX_PRIME_2;
+        unsigned long long lane_3 = seed;
+        unsigned long long lane_4 = seed - XX_PRIME_1;
+
+        while (end - data >= 32)
+        {
+            lane_1 = XxRound(lane_1, XxRead64(data));
+            lane_2 = XxRound(lane_2, XxRead64(data + 8));
+            lane_3 = XxRound(lane_3, XxRead64(data + 16));
+            lane_4 = XxRound(lane_4, XxRead64(data + 24));
 
-        k *= m;
-        k ^= k >> r;
-        k *= m;
+            data += 32;
+        }
 
-        hash *= m;
-        hash ^= k;
+        hash = XxRotl(lane_1, 1) + XxRotl(lane_2, 7) + XxRotl(lane_3, 12) + XxRotl(lane_4, 18);
+        hash = XxMergeRound(hash, lane_1);
+        hash = XxMergeRound(hash, lane_2);
+        hash = XxMergeRound(hash, lane_3);
+        hash = XxMergeRound(hash, lane_4);
+    }
+    else
+        hash = seed + XX_PRIME_5;
+
+    hash += (unsigned long long) size;
 
+    while (end - data >= 8)
+    {
+        hash ^= XxRound(0, XxRead64(data));
+        hash  = XxRotl(hash, 27) * XX_PRIME_1 + XX_PRIME_4;
+        data += 8;
+    }
+
+    if (end - data >= 4)
+    {
+        hash ^= (unsigned long long) XxRead32(data) * XX_PRIME_1;
+        hash  = XxRotl(hash, 23) * XX_PRIME_2 + XX_PRIME_3;
         data += 4;
-        size -= 4;
     }
 
-    switch (size)
+    while (data < end)
     {
-        case 3:         hash ^= data[2] << 16;
-        // fall through
-        case 2:         hash ^= data[8] << 8;
-        // fall through
-        default:        hash ^= data[0];
-                        hash *= m;
+        hash ^= (unsigned long long) (*data) * XX_PRIME_5;
+        hash  = XxRotl(hash, 11) * XX_PRIME_1;
+        data++;
     }
 
-    hash ^= hash >> 13;
-    hash *= m;
-    hash ^= hash >> 15;
+    hash ^= hash >> 33;
+    hash *= XX_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= XX_PRIME_3;
+    hash ^= hash >> 32;
 
     return hash;
 }
+
+//-----------------------------------------------------------------------------------------------------
+
+static hash_t Crc32cTable(const void* obj, size_t size)
+{
+    const unsigned char* data  = (const unsigned char*) obj;
+    const unsigned int*  table = GetCrc32cTable();
+
+    unsigned int crc = ~0U;
+
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static const unsigned int* GetCrc32cTable()
+{
+    struct Crc32cTable
+    {
+        unsigned int values[256];
+    };
+
+    // initialization of function-local static is thread safe, so table is filled once
+    static const Crc32cTable table = []()
+    {
+        Crc32cTable new_table = {};
+
+        for (unsigned int i = 0; i < 256; i++)
+        {
+            unsigned int crc = i;
+
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+
+            new_table.values[i] = crc;
+        }
+
+        return new_table;
+    }();
+
+    return table.values;
+}
+
+#if HASH_X86_64
+
+//-----------------------------------------------------------------------------------------------------
+
+__attribute__((target("sse4.2")))
+static hash_t Crc32cSse42(const void* obj, size_t size)
+{
+    const unsigned char* data = (const unsigned char*) obj;
+
+    unsigned long long crc = ~0U;
+
+    for (; size >= 8; size -= 8, data += 8)
+        crc = _mm_crc32_u64(crc, XxRead64(data));
+
+    unsigned int crc32 = (unsigned int) crc;
+
+    for (; size > 0; size--, data++)
+        crc32 = _mm_crc32_u8(crc32, *data);
+
+    return ~crc32;
+}
+
+#endif
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline unsigned long long XxRound(unsigned long long acc, unsigned long long input)
+{
+    acc += input * XX_PRIME_2;
+    acc  = XxRotl(acc, 31);
+    acc *= XX_PRIME_1;
+
+    return acc;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline unsigned long long XxMergeRound(unsigned long long acc, unsigned long long lane)
+{
+    acc ^= XxRound(0, lane);
+    acc  = acc * XX_PRIME_1 + XX_PRIME_4;
+
+    return acc;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline unsigned long long XxRotl(unsigned long long x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline unsigned long long XxRead64(const unsigned char* data)
+{
+    unsigned long long value = 0;
+    memcpy(&value, data, sizeof(value));
+
+    return value;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline unsigned int XxRead32(const unsigned char* data)
+{
+    unsigned int value = 0;
+    memcpy(&value, data, sizeof(value));
+
+    return value;
+}
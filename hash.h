@@ -6,6 +6,7 @@
 */
 
 #include <stdio.h>
+#include <assert.h>
 
 #include "types.h"
 
@@ -18,4 +19,88 @@
  *************************************************************/
 hash_t MurmurHash (const void* obj, size_t size);
 
+/************************************************************//**
+ * @brief Counts CRC32C (SSE4.2 crc32 instruction if CPU has it, table otherwise)
+ *
+ * @param[in] obj object
+ * @param[in] size object size
+ * @return hash_t object's hash
+ *************************************************************/
+hash_t Crc32cHash (const void* obj, size_t size);
+
+/************************************************************//**
+ * @brief Counts hash by 64-bit xxHash (XXH64, four 8-byte lanes per 32-byte step), folded to hash_t
+ *
+ * @param[in] obj object
+ * @param[in] size object size
+ * @return hash_t object's hash
+ *************************************************************/
+hash_t XxHash (const void* obj, size_t size);
+
+/************************************************************//**
+ * @brief Counts 64-bit xxHash (XXH64)
+ *
+ * @param[in] obj object
+ * @param[in] size object size
+ * @param[in] seed hash seed
+ * @return unsigned long long object's hash
+ *************************************************************/
+unsigned long long XxHash64 (const void* obj, size_t size, unsigned long long seed);
+
+/************************************************************//**
+ * @brief Counts hash by MurmurHash function (inlined version for templates)
+ *
+ * @param[in] obj object
+ * @param[in] size object size
+ * @return hash_t object's hash
+ *************************************************************/
+inline hash_t MurmurHashInline (const void* obj, size_t size)
+{
+    assert(obj);
+
+    const unsigned char* data = (const unsigned char*) obj;
+    const hash_t seed = 0;
+    const hash_t m    = 0x5bd1e995;
+    const int    r    = 24;
+    hash_t       k    = 0;
+
+    hash_t hash = (hash_t) (seed ^ size);
+
+    while (size >= 4)
+    {
+        k  = data[0];
+        k |= data[1] << 8;
+        k |= data[2] << 16;
+        k |= data[3] << 24;
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        hash *= m;
+        hash ^= k;
+
+        data += 4;
+        size -= 4;
+    }
+
+    switch (size)
+    {
+        case 3:         hash ^= data[2] << 16;
+        // fall through
+        case 2:         hash ^= data[1] << 8;
+        // fall through
+        case 1:         hash ^= data[0];
+                        hash *= m;
+                        break;
+        default:        break;
+    }
+
+    hash ^= hash >> 13;
+    hash *= m;
+    hash ^= hash >> 15;
+
+    return hash;
+}
+
 #endif
@@ -2,20 +2,97 @@
 #include <time.h>
 #include <assert.h>
 #include <stdarg.h>
-#include <strings.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 #include "log_funcs.h"
 #include "stack.h"
+#include "poison.h"
+#include "stack_dump.h"
+
+/// @brief async log state
+struct AsyncLog
+{
+    /// ring buffer of records (every record is 8-byte header and payload, padded to 8 bytes)
+    char* ring;
+    /// size of ring buffer (power of 2)
+    size_t size;
+    /// what to do, when ring buffer is full
+    LogFullPolicy policy;
+
+    /// position after last reserved record (positions only grow, ring index is position % size)
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> head;
+    /// position of first record, that is not written yet
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> tail;
+    /// records, that were dropped
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> dropped;
+    /// async mode is on
+    std::atomic<bool> active;
+    /// threads, that append records now (ring is freed, only when they leave)
+    std::atomic<size_t> producers;
+
+    /// writer thread
+    std::thread writer;
+    /// lock of fields below
+    std::mutex lock;
+    /// wakes writer
+    std::condition_variable wake;
+    /// signaled, when writer flushed log file
+    std::condition_variable flushed;
+    /// writer has to finish
+    bool stop;
+    /// amount of threads, that wait in FlushLog
+    size_t flush_waiters;
+    /// all records before this position are written to log file
+    uint64_t flushed_pos;
+};
 
 static FILE* __LOG_STREAM__ = stderr;
 
-static const char* EXTENSION = ".log";
+static FILE* __DUMP_STREAM__ = nullptr;
+
+static AsyncLog ASYNC_LOG = {};
+
+/// stream, that catches PrintLog of this thread, while LogDump formats record
+static thread_local FILE* CAPTURE_STREAM = nullptr;
+
+static const char EXTENSION[] = ".log";
+
+/// size of record header (payload length << 1 | 1, zero while record is not committed)
+static const size_t LOG_HEADER_SIZE   = sizeof(uint64_t);
+/// size of stack buffer, that PrintLog formats record in
+static const size_t LOG_RECORD_SIZE   = 1024;
+/// size of buffer, that writer collects records in before fwrite
+static const size_t LOG_BATCH_SIZE    = 1 << 16;
+/// minimum size of async log ring buffer
+static const size_t LOG_MIN_RING_SIZE = 1 << 12;
+/// how long writer sleeps, if nobody wakes it
+static const std::chrono::milliseconds LOG_WRITE_PERIOD(20);
+
+// ============= STATIC FUNCS ===============
+static void AppendRecord(const char* text, size_t length);
+static void WriterLoop();
+static void DrainRing(char* batch);
+static void StopAsyncLog();
+static void CopyToRing(uint64_t pos, const char* src, size_t length);
+static void CopyFromRing(char* dest, uint64_t pos, size_t length);
+static void ClearRing(uint64_t pos, size_t length);
+static inline uint64_t* GetHeader(uint64_t pos);
+static inline size_t RecordSize(size_t length);
+//============================================
 
 void OpenLogFile(const char* FILE_NAME)
 {
-    char* file_name = strndup(FILE_NAME, MAX_FILE_NAME_LEN);
+    char file_name[MAX_FILE_NAME_LEN + sizeof(EXTENSION)] = "";
 
-    __LOG_STREAM__ = fopen(strncat(file_name, EXTENSION, MAX_FILE_NAME_LEN + sizeof(EXTENSION)), "a");
+    snprintf(file_name, sizeof(file_name), "%.*s%s", (int) MAX_FILE_NAME_LEN, FILE_NAME, EXTENSION);
+
+    __LOG_STREAM__ = fopen(file_name, "a");
 
     if (__LOG_STREAM__ == nullptr)
         __LOG_STREAM__ = stderr;
@@ -36,20 +113,146 @@ void OpenLogFile(const char* FILE_NAME)
         fprintf(__LOG_STREAM__, "[HASH PROTECT ON]\n");
     #endif
 
+    fprintf(__LOG_STREAM__, "[POISON KERNELS %s]\n", PoisonKernelName());
+
     fputc('\n', __LOG_STREAM__);
 
     atexit(CloseLogFile);
-    free(file_name);
 }
 
 //-----------------------------------------------------------------------------------------------------
 
 void CloseLogFile()
 {
+    StopAsyncLog();
+
+    size_t dropped = ASYNC_LOG.dropped.exchange(0);
+    if (dropped != 0)
+        fprintf(__LOG_STREAM__, "[ASYNC LOG DROPPED %zu RECORDS]\n", dropped);
+
     fprintf(__LOG_STREAM__, "*********************************************************************\n"
                             "============================ PROGRAM END ============================\n"
                             "*********************************************************************\n");
-    fclose(__LOG_STREAM__);
+
+    if (__LOG_STREAM__ != stderr)
+        fclose(__LOG_STREAM__);
+
+    __LOG_STREAM__ = stderr;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int OpenDumpFile(const char* FILE_NAME)
+{
+    assert(FILE_NAME);
+
+    char file_name[MAX_FILE_NAME_LEN + sizeof(STACK_DUMP_EXTENSION)] = "";
+
+    snprintf(file_name, sizeof(file_name), "%.*s%s", (int) MAX_FILE_NAME_LEN, FILE_NAME, STACK_DUMP_EXTENSION);
+
+    FILE* stream = fopen(file_name, "ab");
+
+    if (stream == nullptr)
+        return (int) ERRORS::OPEN_FILE;
+
+    CloseDumpFile();
+
+    __DUMP_STREAM__ = stream;
+
+    static bool close_registered = false;
+    if (!close_registered)
+        atexit(CloseDumpFile);
+
+    close_registered = true;
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void CloseDumpFile()
+{
+    if (__DUMP_STREAM__ != nullptr)
+        fclose(__DUMP_STREAM__);
+
+    __DUMP_STREAM__ = nullptr;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+FILE* GetDumpFile()
+{
+    return __DUMP_STREAM__;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int StartAsyncLog(size_t ring_size, LogFullPolicy policy)
+{
+    static bool atexit_set = false;
+
+    if (ASYNC_LOG.active.load())
+        return (int) ERRORS::NONE;
+
+    size_t size = LOG_MIN_RING_SIZE;
+    while (size < ring_size)
+        size *= 2;
+
+    // ring is zeroed, because zero header means, that record is not committed
+    ASYNC_LOG.ring = (char*) calloc(size, 1);
+
+    if (ASYNC_LOG.ring == nullptr)
+        return (int) ERRORS::ALLOCATE_MEMORY;
+
+    ASYNC_LOG.size          = size;
+    ASYNC_LOG.policy        = policy;
+    ASYNC_LOG.stop          = false;
+    ASYNC_LOG.flush_waiters = 0;
+    ASYNC_LOG.flushed_pos   = 0;
+    ASYNC_LOG.head.store(0);
+    ASYNC_LOG.tail.store(0);
+    ASYNC_LOG.dropped.store(0);
+
+    fflush(__LOG_STREAM__);
+
+    ASYNC_LOG.writer = std::thread(WriterLoop);
+    ASYNC_LOG.active.store(true);
+
+    // writer must be joined before program exits, even if log file is not opened
+    if (!atexit_set)
+    {
+        atexit(StopAsyncLog);
+        atexit_set = true;
+    }
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void FlushLog()
+{
+    if (!ASYNC_LOG.active.load())
+    {
+        fflush(__LOG_STREAM__);
+        return;
+    }
+
+    uint64_t target = ASYNC_LOG.head.load(std::memory_order_acquire);
+
+    std::unique_lock<std::mutex> guard(ASYNC_LOG.lock);
+
+    ASYNC_LOG.flush_waiters++;
+    ASYNC_LOG.wake.notify_one();
+    ASYNC_LOG.flushed.wait(guard, [target]() { return ASYNC_LOG.flushed_pos >= target; });
+    ASYNC_LOG.flush_waiters--;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+size_t LogDroppedRecords()
+{
+    return ASYNC_LOG.dropped.load(std::memory_order_relaxed);
 }
 
 //-----------------------------------------------------------------------------------------------------
@@ -59,7 +262,33 @@ int LogDump(dump_f dump_func, const void* stk, const char* func, const char* fil
     assert(dump_func);
     assert(stk);
 
-    return dump_func(__LOG_STREAM__, stk, func, file, line);
+    if (CAPTURE_STREAM == nullptr && !ASYNC_LOG.active.load(std::memory_order_acquire))
+        return dump_func(__LOG_STREAM__, stk, func, file, line);
+
+    // dump functions print by fprintf and by PrintLog, both go to one memory stream
+    char*  text   = nullptr;
+    size_t length = 0;
+    FILE*  stream = open_memstream(&text, &length);
+
+    if (stream == nullptr)
+        return dump_func(__LOG_STREAM__, stk, func, file, line);
+
+    FILE* outer_capture = CAPTURE_STREAM;
+    CAPTURE_STREAM      = stream;
+
+    int result = dump_func(stream, stk, func, file, line);
+
+    CAPTURE_STREAM = outer_capture;
+    fclose(stream);
+
+    if (outer_capture != nullptr)
+        fwrite(text, 1, length, outer_capture);
+    else
+        AppendRecord(text, length);
+
+    free(text);
+
+    return result;
 }
 
 //-----------------------------------------------------------------------------------------------------
@@ -70,9 +299,259 @@ int PrintLog (const char *format, ...)
   int done;
 
   va_start (arg, format);
-  done = vfprintf(__LOG_STREAM__, format, arg);
+
+  if (CAPTURE_STREAM != nullptr)
+      done = vfprintf(CAPTURE_STREAM, format, arg);
+
+  else if (!ASYNC_LOG.active.load(std::memory_order_acquire))
+      done = vfprintf(__LOG_STREAM__, format, arg);
+
+  else
+  {
+      char record[LOG_RECORD_SIZE] = "";
+
+      va_list arg_copy;
+      va_copy (arg_copy, arg);
+      done = vsnprintf(record, sizeof(record), format, arg_copy);
+      va_end (arg_copy);
+
+      if (done >= 0 && (size_t) done < sizeof(record))
+          AppendRecord(record, (size_t) done);
+
+      else if (done >= 0)
+      {
+          char* long_record = (char*) calloc((size_t) done + 1, 1);
+
+          if (long_record != nullptr)
+          {
+              vsnprintf(long_record, (size_t) done + 1, format, arg);
+              AppendRecord(long_record, (size_t) done);
+              free(long_record);
+          }
+      }
+  }
+
   va_end (arg);
 
   return done;
 }
 
+//-----------------------------------------------------------------------------------------------------
+
+static void AppendRecord(const char* text, size_t length)
+{
+    assert(text);
+
+    // producer is counted before active is read, so StopAsyncLog either waits for it or it sees async log stopped
+    ASYNC_LOG.producers.fetch_add(1);
+
+    if (!ASYNC_LOG.active.load())
+    {
+        ASYNC_LOG.producers.fetch_sub(1);
+        fwrite(text, 1, length, __LOG_STREAM__);
+        return;
+    }
+
+    uint64_t need = RecordSize(length);
+
+    // record, that never fits in ring, is written synchronously after everything before it
+    if (need > ASYNC_LOG.size)
+    {
+        FlushLog();
+        fwrite(text, 1, length, __LOG_STREAM__);
+
+        ASYNC_LOG.producers.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+
+    uint64_t pos = ASYNC_LOG.head.load(std::memory_order_relaxed);
+
+    while (true)
+    {
+        uint64_t tail = ASYNC_LOG.tail.load(std::memory_order_acquire);
+
+        if (pos + need - tail > ASYNC_LOG.size)
+        {
+            ASYNC_LOG.wake.notify_one();
+
+            if (ASYNC_LOG.policy == LOG_DROP)
+            {
+                ASYNC_LOG.dropped.fetch_add(1, std::memory_order_relaxed);
+                ASYNC_LOG.producers.fetch_sub(1, std::memory_order_release);
+                return;
+            }
+
+            std::this_thread::yield();
+            pos = ASYNC_LOG.head.load(std::memory_order_relaxed);
+            continue;
+        }
+
+        if (ASYNC_LOG.head.compare_exchange_weak(pos, pos + need, std::memory_order_relaxed))
+            break;
+    }
+
+    CopyToRing(pos + LOG_HEADER_SIZE, text, length);
+
+    // header commits record, so payload must be visible before it
+    __atomic_store_n(GetHeader(pos), (length << 1) | 1, __ATOMIC_RELEASE);
+
+    ASYNC_LOG.producers.fetch_sub(1, std::memory_order_release);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void WriterLoop()
+{
+    char* batch = (char*) calloc(LOG_BATCH_SIZE, 1);
+
+    while (true)
+    {
+        DrainRing(batch);
+
+        std::unique_lock<std::mutex> guard(ASYNC_LOG.lock);
+
+        ASYNC_LOG.flushed_pos = ASYNC_LOG.tail.load(std::memory_order_relaxed);
+        ASYNC_LOG.flushed.notify_all();
+
+        if (ASYNC_LOG.stop && ASYNC_LOG.flushed_pos == ASYNC_LOG.head.load(std::memory_order_acquire))
+            break;
+
+        ASYNC_LOG.wake.wait_for(guard, LOG_WRITE_PERIOD, []()
+        {
+            return ASYNC_LOG.stop || (ASYNC_LOG.flush_waiters != 0 &&
+                                      ASYNC_LOG.flushed_pos < ASYNC_LOG.head.load(std::memory_order_acquire));
+        });
+    }
+
+    free(batch);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void DrainRing(char* batch)
+{
+    uint64_t tail   = ASYNC_LOG.tail.load(std::memory_order_relaxed);
+    uint64_t head   = ASYNC_LOG.head.load(std::memory_order_acquire);
+    size_t   filled = 0;
+
+    while (tail < head)
+    {
+        uint64_t header = __atomic_load_n(GetHeader(tail), __ATOMIC_ACQUIRE);
+
+        // record is reserved, but its writer has not committed it yet
+        if (header == 0)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        size_t length = header >> 1;
+        size_t need   = RecordSize(length);
+        bool   fits   = batch != nullptr && length <= LOG_BATCH_SIZE;
+
+        if (filled != 0 && (!fits || filled + length > LOG_BATCH_SIZE))
+        {
+            fwrite(batch, 1, filled, __LOG_STREAM__);
+            filled = 0;
+        }
+
+        if (fits)
+        {
+            CopyFromRing(batch + filled, tail + LOG_HEADER_SIZE, length);
+            filled += length;
+        }
+        else
+        {
+            // record is bigger than batch, it is written right from ring
+            size_t index = (tail + LOG_HEADER_SIZE) & (ASYNC_LOG.size - 1);
+            size_t first = (length < ASYNC_LOG.size - index) ? length : ASYNC_LOG.size - index;
+
+            fwrite(ASYNC_LOG.ring + index, 1, first, __LOG_STREAM__);
+            fwrite(ASYNC_LOG.ring, 1, length - first, __LOG_STREAM__);
+        }
+
+        // freed space must be zero, because some of its words become headers of next records
+        ClearRing(tail, need);
+        tail += need;
+        ASYNC_LOG.tail.store(tail, std::memory_order_release);
+
+        if (tail == head)
+            head = ASYNC_LOG.head.load(std::memory_order_acquire);
+    }
+
+    if (filled != 0)
+        fwrite(batch, 1, filled, __LOG_STREAM__);
+
+    fflush(__LOG_STREAM__);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void StopAsyncLog()
+{
+    // new records go to log file directly, records, that are being appended, get into ring before writer stops
+    if (!ASYNC_LOG.active.exchange(false))
+        return;
+
+    while (ASYNC_LOG.producers.load(std::memory_order_acquire) != 0)
+        std::this_thread::yield();
+
+    {
+        std::lock_guard<std::mutex> guard(ASYNC_LOG.lock);
+        ASYNC_LOG.stop = true;
+    }
+
+    ASYNC_LOG.wake.notify_one();
+    ASYNC_LOG.writer.join();
+
+    free(ASYNC_LOG.ring);
+    ASYNC_LOG.ring = nullptr;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void CopyToRing(uint64_t pos, const char* src, size_t length)
+{
+    size_t index = pos & (ASYNC_LOG.size - 1);
+    size_t first = (length < ASYNC_LOG.size - index) ? length : ASYNC_LOG.size - index;
+
+    memcpy(ASYNC_LOG.ring + index, src, first);
+    memcpy(ASYNC_LOG.ring, src + first, length - first);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void CopyFromRing(char* dest, uint64_t pos, size_t length)
+{
+    size_t index = pos & (ASYNC_LOG.size - 1);
+    size_t first = (length < ASYNC_LOG.size - index) ? length : ASYNC_LOG.size - index;
+
+    memcpy(dest, ASYNC_LOG.ring + index, first);
+    memcpy(dest + first, ASYNC_LOG.ring, length - first);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void ClearRing(uint64_t pos, size_t length)
+{
+    size_t index = pos & (ASYNC_LOG.size - 1);
+    size_t first = (length < ASYNC_LOG.size - index) ? length : ASYNC_LOG.size - index;
+
+    memset(ASYNC_LOG.ring + index, 0, first);
+    memset(ASYNC_LOG.ring, 0, length - first);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline uint64_t* GetHeader(uint64_t pos)
+{
+    // records are 8-byte aligned and ring size is power of 2, so header never wraps
+    return (uint64_t*) (ASYNC_LOG.ring + (pos & (ASYNC_LOG.size - 1)));
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline size_t RecordSize(size_t length)
+{
+    return LOG_HEADER_SIZE + ((length + LOG_HEADER_SIZE - 1) & ~(LOG_HEADER_SIZE - 1));
+}
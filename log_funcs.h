@@ -11,6 +11,18 @@
 
 static const size_t MAX_FILE_NAME_LEN = 100;
 
+/// default size of async log ring buffer
+static const size_t LOG_RING_SIZE = 1 << 20;
+
+/// @brief what async log does with record, when its ring buffer is full
+enum LogFullPolicy
+{
+    /// record is dropped (and counted)
+    LOG_DROP,
+    /// caller waits, until writer frees space
+    LOG_BLOCK
+};
+
 /************************************************************//**
  * @brief Opens log file, also close it when program shuts down
  *
@@ -19,10 +31,53 @@ static const size_t MAX_FILE_NAME_LEN = 100;
 void OpenLogFile(const char* FILE_NAME);
 
 /************************************************************//**
- * @brief Closes log file
+ * @brief Closes log file (async log is drained before)
  ************************************************************/
 void CloseLogFile();
 
+/************************************************************//**
+ * @brief Opens binary dump file (FILE_NAME.stkdump), StackDump writes binary records
+ * there and only a reference to record in log, also closes it when program shuts down
+ *
+ * @param[in] FILE_NAME name of dump file
+ * @return int error code
+ ************************************************************/
+int OpenDumpFile(const char* FILE_NAME);
+
+/************************************************************//**
+ * @brief Closes binary dump file, StackDump prints text dumps again
+ ************************************************************/
+void CloseDumpFile();
+
+/************************************************************//**
+ * @brief Gives binary dump file
+ *
+ * @return FILE* binary dump file (nullptr, if it is not opened)
+ ************************************************************/
+FILE* GetDumpFile();
+
+/************************************************************//**
+ * @brief Starts async log: PrintLog and LogDump append records to ring buffer,
+ * background thread writes them to log file by big batches
+ *
+ * @param[in] ring_size size of ring buffer in bytes (rounded up to power of 2)
+ * @param[in] policy what to do with record, when ring buffer is full
+ * @return int error code
+ ************************************************************/
+int StartAsyncLog(size_t ring_size = LOG_RING_SIZE, LogFullPolicy policy = LOG_DROP);
+
+/************************************************************//**
+ * @brief Waits, until every record, that was logged before call, is written to log file
+ ************************************************************/
+void FlushLog();
+
+/************************************************************//**
+ * @brief Counts records, that were dropped by async log because of full ring buffer
+ *
+ * @return size_t amount of dropped records
+ ************************************************************/
+size_t LogDroppedRecords();
+
 /************************************************************//**
  * @brief Dumping information in logs
  *
@@ -5,6 +5,7 @@
 #include "log_funcs.h"
 #include "types.h"
 #include "hash.h"
+#include "tstack.h"
 
 int main(const int argc, const char* argv[])
 {
@@ -16,6 +17,25 @@ int main(const int argc, const char* argv[])
     Stack_t stk            = {};
     struct ErrorInfo error = {};
 
+    TStack<double, NoProtection, NoHash> fast_stk;
+    TStack<double>                       safe_stk;
+
+    error.code = (ERRORS) fast_stk.Ctor();
+    EXIT_IF_ERROR(&error);
+    error.code = (ERRORS) safe_stk.Ctor();
+    EXIT_IF_ERROR(&error);
+
+    double value = 0;
+
+    error.code = (ERRORS) fast_stk.Push(0.5);
+    EXIT_IF_ERROR(&error);
+    error.code = (ERRORS) fast_stk.Pop(&value);
+    EXIT_IF_ERROR(&error);
+    error.code = (ERRORS) safe_stk.Push(value);
+    EXIT_IF_ERROR(&error);
+
+    LogDump(TStack<double>::Dump, &safe_stk, __func__, __FILE__, __LINE__);
+
     error.code = (ERRORS) StackCtor(&stk);
     EXIT_IF_ERROR(&error);
 
@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "poison.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define POISON_X86 1
+
+#else
+#define POISON_X86 0
+#endif
+
+static_assert(sizeof(elem_t) == 8, "poison kernels work with 64-bit elements");
+
+/// @brief poison kernels for one instruction set
+struct PoisonKernels
+{
+    /// fill kernel
+    void (*fill)  (elem_t* data, size_t count, elem_t poison);
+    /// check kernel
+    bool (*check) (const elem_t* data, size_t count, elem_t poison);
+    /// instruction set name
+    const char* name;
+};
+
+// ============= STATIC FUNCS ===============
+static const PoisonKernels* GetPoisonKernels();
+static PoisonKernels ChoosePoisonKernels();
+
+static void PoisonFillScalar(elem_t* data, size_t count, elem_t poison);
+static bool PoisonCheckScalar(const elem_t* data, size_t count, elem_t poison);
+
+#if POISON_X86
+static void PoisonFillSse2(elem_t* data, size_t count, elem_t poison);
+static bool PoisonCheckSse2(const elem_t* data, size_t count, elem_t poison);
+static void PoisonFillAvx2(elem_t* data, size_t count, elem_t poison);
+static bool PoisonCheckAvx2(const elem_t* data, size_t count, elem_t poison);
+static void PoisonFillAvx512(elem_t* data, size_t count, elem_t poison);
+static bool PoisonCheckAvx512(const elem_t* data, size_t count, elem_t poison);
+#endif
+//============================================
+
+void PoisonFill(elem_t* data, size_t count, elem_t poison)
+{
+    assert(data || count == 0);
+
+    GetPoisonKernels()->fill(data, count, poison);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+bool PoisonCheck(const elem_t* data, size_t count, elem_t poison)
+{
+    assert(data || count == 0);
+
+    return GetPoisonKernels()->check(data, count, poison);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+const char* PoisonKernelName()
+{
+    return GetPoisonKernels()->name;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static const PoisonKernels* GetPoisonKernels()
+{
+    static const PoisonKernels kernels = ChoosePoisonKernels();
+
+    return &kernels;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static PoisonKernels ChoosePoisonKernels()
+{
+#if POISON_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f"))
+        return {PoisonFillAvx512, PoisonCheckAvx512, "AVX-512"};
+
+    if (__builtin_cpu_supports("avx2"))
+        return {PoisonFillAvx2, PoisonCheckAvx2, "AVX2"};
+
+    if (__builtin_cpu_supports("sse2"))
+        return {PoisonFillSse2, PoisonCheckSse2, "SSE2"};
+#endif
+
+    return {PoisonFillScalar, PoisonCheckScalar, "SCALAR"};
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void PoisonFillScalar(elem_t* data, size_t count, elem_t poison)
+{
+    for (size_t i = 0; i < count; i++)
+        data[i] = poison;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static bool PoisonCheckScalar(const elem_t* data, size_t count, elem_t poison)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (memcmp(&data[i], &poison, sizeof(elem_t)) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+#if POISON_X86
+
+//-----------------------------------------------------------------------------------------------------
+
+__attribute__((target("sse2")))
+static void PoisonFillSse2(elem_t* data, size_t count, elem_t poison)
+{
+    const __m128i pattern = _mm_set1_epi64x(poison);
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2)
+        _mm_storeu_si128((__m128i*)(data + i), pattern);
+
+    PoisonFillScalar(data + i, count - i, poison);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+__attribute__((target("sse2")))
+static bool PoisonCheckSse2(const elem_t* data, size_t count, elem_t poison)
+{
+    const __m128i pattern = _mm_set1_epi64x(poison);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i diff = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(data + i)),     pattern);
+        diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(data + i + 2)), pattern));
+        diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(data + i + 4)), pattern));
+        diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(data + i + 6)), pattern));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF)
+            return false;
+    }
+
+    return PoisonCheckScalar(data + i, count - i, poison);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+__attribute__((target("avx2")))
+static void PoisonFillAvx2(elem_t* data, size_t count, elem_t poison)
+{
+    const __m256i pattern = _mm256_set1_epi64x(poison);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm256_storeu_si256((__m256i*)(data + i), pattern);
+
+    PoisonFillScalar(data + i, count - i, poison);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+__attribute__((target("avx2")))
+static bool PoisonCheckAvx2(const elem_t* data, size_t count, elem_t poison)
+{
+    const __m256i pattern = _mm256_set1_epi64x(poison);
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256i diff = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(data + i)),     pattern);
+        diff = _mm256_or_si256(diff, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(data + i + 4)),  pattern));
+        diff = _mm256_or_si256(diff, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(data + i + 8)),  pattern));
+        diff = _mm256_or_si256(diff, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(data + i + 12)), pattern));
+
+        if (!_mm256_testz_si256(diff, diff))
+            return false;
+    }
+
+    return PoisonCheckScalar(data + i, count - i, poison);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+__attribute__((target("avx512f")))
+static void PoisonFillAvx512(elem_t* data, size_t count, elem_t poison)
+{
+    const __m512i pattern = _mm512_set1_epi64(poison);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm512_storeu_si512((void*)(data + i), pattern);
+
+    PoisonFillScalar(data + i, count - i, poison);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+__attribute__((target("avx512f")))
+static bool PoisonCheckAvx512(const elem_t* data, size_t count, elem_t poison)
+{
+    const __m512i pattern = _mm512_set1_epi64(poison);
+
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        __m512i diff = _mm512_xor_si512(_mm512_loadu_si512((const void*)(data + i)),     pattern);
+        diff = _mm512_or_si512(diff, _mm512_xor_si512(_mm512_loadu_si512((const void*)(data + i + 8)),  pattern));
+        diff = _mm512_or_si512(diff, _mm512_xor_si512(_mm512_loadu_si512((const void*)(data + i + 16)), pattern));
+        diff = _mm512_or_si512(diff, _mm512_xor_si512(_mm512_loadu_si512((const void*)(data + i + 24)), pattern));
+
+        if (_mm512_test_epi64_mask(diff, diff) != 0)
+            return false;
+    }
+
+    return PoisonCheckScalar(data + i, count - i, poison);
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef __POISON_H_
+#define __POISON_H_
+
+/*! \file
+* \brief Contains poison fill and verification kernels
+*/
+
+#include <stdio.h>
+
+#include "types.h"
+
+// memory poisoning of instrumented builds (SANITIZER_POISON mode), it is empty in uninstrumented ones
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/asan_interface.h>
+#define POISON_REGION(addr, size)   ASAN_POISON_MEMORY_REGION(addr, size)
+#define UNPOISON_REGION(addr, size) ASAN_UNPOISON_MEMORY_REGION(addr, size)
+
+#elif __has_include(<valgrind/memcheck.h>)
+#include <valgrind/memcheck.h>
+#define POISON_REGION(addr, size)   VALGRIND_MAKE_MEM_NOACCESS(addr, size)
+#define UNPOISON_REGION(addr, size) VALGRIND_MAKE_MEM_UNDEFINED(addr, size)
+
+#else
+#define POISON_REGION(addr, size)   ((void) (addr), (void) (size))
+#define UNPOISON_REGION(addr, size) ((void) (addr), (void) (size))
+#endif
+
+/************************************************************//**
+ * @brief Fills elements with poison value
+ *
+ * @param[out] data first element
+ * @param[in] count amount of elements
+ * @param[in] poison poison value
+ *************************************************************/
+void PoisonFill(elem_t* data, size_t count, elem_t poison);
+
+/************************************************************//**
+ * @brief Checks, that all elements are equal to poison value
+ *
+ * @param[in] data first element
+ * @param[in] count amount of elements
+ * @param[in] poison poison value
+ * @return true if all elements are poisoned
+ *************************************************************/
+bool PoisonCheck(const elem_t* data, size_t count, elem_t poison);
+
+/************************************************************//**
+ * @brief Name of kernels, that were chosen for this CPU
+ *
+ * @return const char* "AVX-512", "AVX2", "SSE2" or "SCALAR"
+ *************************************************************/
+const char* PoisonKernelName();
+
+#endif
@@ -0,0 +1,776 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "seg_stack.h"
+#include "log_funcs.h"
+#include "hash.h"
+#include "poison.h"
+
+// ============= STATIC FUNCS ===============
+static SegChunk* ChunkCtor(SegStack* seg, const size_t capacity);
+static void ChunkDtor(SegStack* seg, SegChunk* chunk);
+static inline size_t CountChunkSize(const size_t capacity);
+static int AddChunk(SegStack* seg);
+static void ReleaseChunk(SegStack* seg);
+
+#if HASH_PROTECT
+static inline hash_t SlotHash(const SegStack* seg, const size_t index, const elem_t value);
+static hash_t CountHeaderHash(const SegStack* seg, const SegChunk* chunk);
+static hash_t CountDataHash(const SegStack* seg, const SegChunk* chunk, const size_t used);
+static hash_t CountSegHash(const SegStack* seg);
+static bool ScrubTopChunk(SegStack* seg);
+#endif
+static inline void ReInitHeaderHash(SegStack* seg, SegChunk* chunk);
+static inline void ReInitSegHash(SegStack* seg);
+
+#if CANARY_PROTECT
+static canary_t* GetPrefixChunkCanary(const SegChunk* chunk);
+static canary_t* GetPostfixChunkCanary(const SegChunk* chunk);
+#endif
+static int SegCheck(SegStack* seg);
+static int ChunkCheck(const SegStack* seg, const SegChunk* chunk, const size_t used, const bool full);
+static int ReportCorruption(SegStack* seg, const int condition, const char* func, const char* file, const int line);
+static void PrintSegCondition(const SegStack* seg);
+//============================================
+
+#ifdef REPORT_CORRUPTION
+#undef REPORT_CORRUPTION
+
+#endif
+#define REPORT_CORRUPTION(seg, condition) ReportCorruption(seg, condition, __func__, __FILE__, __LINE__)
+
+#ifdef CHECK_SEG
+#undef CHECK_SEG
+
+#endif
+#define CHECK_SEG(seg)  do                                                  \
+                        {                                                   \
+                            int condition_ = SegCheck(seg);                 \
+                            if (condition_ != OK)                           \
+                                return REPORT_CORRUPTION(seg, condition_);  \
+                        } while (0)
+
+// =============CONSTS============
+static const canary_t canary_val = STACK_CANARY;
+static const elem_t POISON       = STACK_POISON;
+// ===============================
+
+int SegStackCtor(SegStack* seg, size_t min_chunk, size_t max_chunk)
+{
+    assert(seg);
+
+    if (seg->allocator == nullptr)
+        seg->allocator = &MALLOC_ALLOCATOR;
+
+    ON_HASH
+    (
+        if (seg->hash_func == nullptr)
+            seg->hash_func = MurmurHash
+    );
+
+    if (min_chunk == 0)
+        min_chunk = SEG_MIN_CHUNK;
+
+    if (max_chunk < min_chunk)
+        max_chunk = min_chunk;
+
+    seg->top          = nullptr;
+    seg->cache        = nullptr;
+    seg->size         = 0;
+    seg->top_size     = 0;
+    seg->chunks       = 0;
+    seg->min_chunk    = min_chunk;
+    seg->max_chunk    = max_chunk;
+    seg->status       = OK;
+    seg->chunk_allocs = 0;
+    seg->cache_hits   = 0;
+
+    ON_HASH
+    (
+        seg->scrub_pos = 0;
+        seg->scrub_acc = 0
+    );
+
+    ON_CANARY
+    (
+        seg->seg_prefix  = canary_val;
+        seg->seg_postfix = canary_val
+    );
+
+    int error = AddChunk(seg);
+
+    if (error != (int) ERRORS::NONE)
+        return error;
+
+    ReInitSegHash(seg);
+
+    CHECK_SEG(seg);
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int SegStackDtor(SegStack* seg)
+{
+    assert(seg);
+
+    CHECK_SEG(seg);
+
+    while (seg->top != nullptr)
+    {
+        SegChunk* prev = seg->top->prev;
+
+        ChunkDtor(seg, seg->top);
+        seg->top = prev;
+    }
+
+    if (seg->cache != nullptr)
+        ChunkDtor(seg, seg->cache);
+
+    seg->cache    = nullptr;
+    seg->size     = 0;
+    seg->top_size = 0;
+    seg->chunks   = 0;
+    seg->status   = OK;
+
+    ON_CANARY
+    (
+        seg->seg_prefix  = 0;
+        seg->seg_postfix = 0
+    );
+
+    ON_HASH
+    (
+        seg->hash_func  = nullptr;
+        seg->stack_hash = 0
+    );
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int SegStackPush(SegStack* seg, elem_t value)
+{
+    assert(seg);
+
+    CHECK_SEG(seg);
+
+    if (seg->top_size == seg->top->capacity)
+    {
+        int error = AddChunk(seg);
+
+        if (error != (int) ERRORS::NONE)
+            return error;
+    }
+
+    SegChunk* chunk = seg->top;
+
+    // empty slot was written by somebody
+    if (chunk->data[seg->top_size] != POISON)
+        return REPORT_CORRUPTION(seg, POISON_ACCESS);
+
+    ON_HASH
+    (
+        chunk->data_hash ^= SlotHash(seg, seg->top_size, value)
+    );
+
+    chunk->data[seg->top_size++] = value;
+    seg->size++;
+
+    ReInitSegHash(seg);
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int SegStackPop(SegStack* seg, elem_t* ret_value)
+{
+    assert(seg);
+    assert(ret_value);
+
+    CHECK_SEG(seg);
+
+    if (seg->size == 0)
+        return (int) ERRORS::EMPTY_STACK;
+
+    SegChunk* chunk = seg->top;
+    size_t index    = --seg->top_size;
+    elem_t value    = chunk->data[index];
+
+    if (value == POISON)
+        return REPORT_CORRUPTION(seg, POISON_ACCESS);
+
+    ON_HASH
+    (
+        hash_t slot_hash  = SlotHash(seg, index, value);
+        chunk->data_hash ^= slot_hash;
+
+        // slot was folded by verification, so verification continues from it
+        if (index < seg->scrub_pos)
+        {
+            seg->scrub_acc ^= slot_hash;
+            seg->scrub_pos  = index;
+        }
+    );
+
+    chunk->data[index] = POISON;
+    seg->size--;
+
+    // first chunk is kept, even if it is empty
+    if (seg->top_size == 0 && chunk->prev != nullptr)
+        ReleaseChunk(seg);
+
+    ReInitSegHash(seg);
+
+    *(ret_value) = value;
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int SegStackDump(FILE* fp, const void* seg_stack, const char* func, const char* file, const int line)
+{
+    assert(seg_stack);
+    assert(func);
+    assert(file);
+
+    const SegStack* seg = (const SegStack*) seg_stack;
+
+    LOG_START_MOD(func, file, line);
+
+    fprintf(fp, "SegStack             > [%p]\n"
+                "size                 > %zu\n"
+                "top size             > %zu\n"
+                "chunks               > %zu\n"
+                "chunk capacities     > %zu - %zu\n"
+                "top chunk            > [%p]\n"
+                "cached chunk         > [%p]\n"
+                "chunk allocs         > %zu\n"
+                "cache hits           > %zu\n",
+                seg, seg->size, seg->top_size, seg->chunks, seg->min_chunk, seg->max_chunk,
+                seg->top, seg->cache, seg->chunk_allocs, seg->cache_hits);
+
+    ON_CANARY
+    (
+        fprintf(fp, "STACK PREFIX CANARY  > %llX\n"
+                    "STACK POSTFIX CANARY > %llX\n",
+                    seg->seg_prefix, seg->seg_postfix)
+    );
+
+    ON_HASH
+    (
+        fprintf(fp, "STACK HASH           > %u\n", seg->stack_hash)
+    );
+
+    fprintf(fp, "ELEMENTS: \n\n");
+
+    // list is printed from top, chunks are not trusted beyond amount, that stack counts
+    size_t used  = seg->top_size;
+    size_t first = seg->size;
+
+    const SegChunk* chunk = seg->top;
+
+    for (size_t i = 0; i < seg->chunks && chunk != nullptr; i++)
+    {
+        if (used > chunk->capacity || used > first)
+            break;
+
+        first -= used;
+
+        fprintf(fp, "CHUNK [%p] CAPACITY %zu\n", chunk, chunk->capacity);
+
+        ON_CANARY
+        (
+            fprintf(fp, "PREFIX DATA CANARY   > %llX\n"
+                        "POSTFIX DATA CANARY  > %llX\n",
+                        *GetPrefixChunkCanary(chunk), *GetPostfixChunkCanary(chunk))
+        );
+
+        for (size_t index = used; index > 0; index--)
+            fprintf(fp, "[%zu] " PRINT_ELEM_T "\n", first + index - 1, chunk->data[index - 1]);
+
+        chunk = chunk->prev;
+        used  = (chunk != nullptr) ? chunk->capacity : 0;
+    }
+
+    if (seg->status != OK)
+        PrintSegCondition(seg);
+
+    LOG_END();
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int SegStackOk(const SegStack* seg_stack)
+{
+    assert(seg_stack);
+
+#pragma GCC diagnostic ignored "-Wcast-qual"
+    SegStack* seg = (SegStack*) seg_stack;
+#pragma GCC diagnostic warning "-Wcast-qual"
+
+    if (SegCheck(seg) != OK)
+        return seg->status;
+
+    size_t elements = 0;
+    size_t chunks   = 0;
+    size_t used     = seg->top_size;
+
+    for (const SegChunk* chunk = seg->top; chunk != nullptr; chunk = chunk->prev)
+    {
+        // list, that is longer than stack counts, is broken (it can be looped)
+        if (++chunks > seg->chunks)
+        {
+            seg->status |= INVALID_DATA;
+            break;
+        }
+
+        seg->status |= ChunkCheck(seg, chunk, used, true);
+
+        elements += used;
+
+        if (chunk->prev != nullptr)
+            used = chunk->prev->capacity;
+    }
+
+    if (chunks != seg->chunks)                                      seg->status |= INVALID_DATA;
+    if (elements != seg->size)                                      seg->status |= INVALID_SIZE;
+
+    if (seg->cache != nullptr)
+        seg->status |= ChunkCheck(seg, seg->cache, 0, true);
+
+    return seg->status;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static SegChunk* ChunkCtor(SegStack* seg, const size_t capacity)
+{
+    assert(seg);
+
+    SegChunk* chunk = (SegChunk*) seg->allocator->alloc(seg->allocator->ctx, CountChunkSize(capacity));
+
+    if (chunk == nullptr)
+        return nullptr;
+
+    char* data = (char*) chunk + sizeof(SegChunk);
+
+    ON_CANARY
+    (
+        *(canary_t*) data = canary_val;
+        data += sizeof(canary_t);
+        *(canary_t*)(data + capacity * sizeof(elem_t)) = canary_val
+    );
+
+    chunk->prev     = nullptr;
+    chunk->capacity = capacity;
+    chunk->data     = (elem_t*) data;
+
+    PoisonFill(chunk->data, capacity, POISON);
+
+    ON_HASH
+    (
+        chunk->data_hash = 0
+    );
+
+    seg->chunk_allocs++;
+
+    return chunk;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void ChunkDtor(SegStack* seg, SegChunk* chunk)
+{
+    assert(seg);
+    assert(chunk);
+
+    seg->allocator->free(seg->allocator->ctx, chunk, CountChunkSize(chunk->capacity));
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline size_t CountChunkSize(const size_t capacity)
+{
+    size_t size = sizeof(SegChunk) + capacity * sizeof(elem_t);
+
+    ON_CANARY
+    (
+        size += 2 * sizeof(canary_t)
+    );
+
+    return size;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static int AddChunk(SegStack* seg)
+{
+    assert(seg);
+
+    size_t capacity = seg->min_chunk;
+
+    if (seg->top != nullptr)
+    {
+        capacity = seg->top->capacity * 2;
+
+        if (capacity > seg->max_chunk)
+            capacity = seg->max_chunk;
+    }
+
+    SegChunk* chunk = seg->cache;
+
+    // cached chunk was above current top, so it usually has capacity, that is needed
+    if (chunk != nullptr && chunk->capacity != capacity)
+    {
+        ChunkDtor(seg, chunk);
+        chunk = nullptr;
+    }
+
+    seg->cache = nullptr;
+
+    if (chunk != nullptr)
+        seg->cache_hits++;
+    else
+        chunk = ChunkCtor(seg, capacity);
+
+    if (chunk == nullptr)
+        return (int) ERRORS::ALLOCATE_MEMORY;
+
+    chunk->prev = seg->top;
+    ReInitHeaderHash(seg, chunk);
+
+    seg->top      = chunk;
+    seg->top_size = 0;
+    seg->chunks++;
+
+    ON_HASH
+    (
+        seg->scrub_pos = 0;
+        seg->scrub_acc = 0
+    );
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void ReleaseChunk(SegStack* seg)
+{
+    assert(seg);
+    assert(seg->top);
+    assert(seg->top->prev);
+
+    SegChunk* chunk = seg->top;
+
+    seg->top      = chunk->prev;
+    seg->top_size = seg->top->capacity;
+    seg->chunks--;
+
+    ON_HASH
+    (
+        seg->scrub_pos = 0;
+        seg->scrub_acc = 0
+    );
+
+    // only last released chunk is kept, chunk above it can be needed only after this one
+    if (seg->cache != nullptr)
+        ChunkDtor(seg, seg->cache);
+
+    chunk->prev = nullptr;
+    ReInitHeaderHash(seg, chunk);
+
+    seg->cache = chunk;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+#if HASH_PROTECT
+static inline hash_t SlotHash(const SegStack* seg, const size_t index, const elem_t value)
+{
+    assert(seg);
+
+    struct
+    {
+        size_t index;
+        elem_t value;
+    } slot = {index, value};
+
+    return seg->hash_func(&slot, sizeof(slot));
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static hash_t CountHeaderHash(const SegStack* seg, const SegChunk* chunk)
+{
+    assert(seg);
+    assert(chunk);
+
+    struct
+    {
+        const SegChunk* prev;
+        size_t capacity;
+        const elem_t* data;
+    } header = {chunk->prev, chunk->capacity, chunk->data};
+
+    return seg->hash_func(&header, sizeof(header));
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static hash_t CountDataHash(const SegStack* seg, const SegChunk* chunk, const size_t used)
+{
+    assert(seg);
+    assert(chunk);
+
+    hash_t new_hash = 0;
+
+    for (size_t i = 0; i < used; i++)
+        new_hash ^= SlotHash(seg, i, chunk->data[i]);
+
+    return new_hash;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static hash_t CountSegHash(const SegStack* seg)
+{
+    assert(seg);
+
+    // fields, that change without stack being changed, are not hashed
+    SegStack snapshot = {};
+    memcpy(&snapshot, seg, sizeof(SegStack));
+
+    snapshot.status       = 0;
+    snapshot.stack_hash   = 0;
+    snapshot.scrub_pos    = 0;
+    snapshot.scrub_acc    = 0;
+    snapshot.chunk_allocs = 0;
+    snapshot.cache_hits   = 0;
+
+    return seg->hash_func(&snapshot, sizeof(SegStack));
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static bool ScrubTopChunk(SegStack* seg)
+{
+    assert(seg);
+    assert(seg->top);
+
+    const SegChunk* chunk = seg->top;
+
+    size_t end = seg->scrub_pos + HASH_SCRUB_STEP;
+    if (end > seg->top_size)
+        end = seg->top_size;
+
+    for (size_t i = seg->scrub_pos; i < end; i++)
+        seg->scrub_acc ^= SlotHash(seg, i, chunk->data[i]);
+
+    seg->scrub_pos = end;
+
+    if (end < seg->top_size)
+        return true;
+
+    hash_t scrubbed_hash = seg->scrub_acc;
+
+    seg->scrub_pos = 0;
+    seg->scrub_acc = 0;
+
+    return scrubbed_hash == chunk->data_hash;
+}
+#endif
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline void ReInitHeaderHash(SegStack* seg, SegChunk* chunk)
+{
+    assert(seg);
+    assert(chunk);
+
+    ON_HASH
+    (
+        chunk->header_hash = CountHeaderHash(seg, chunk)
+    );
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline void ReInitSegHash(SegStack* seg)
+{
+    assert(seg);
+
+    ON_HASH
+    (
+        seg->stack_hash = CountSegHash(seg)
+    );
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+#if CANARY_PROTECT
+static canary_t* GetPrefixChunkCanary(const SegChunk* chunk)
+{
+    assert(chunk);
+
+    return (canary_t*) chunk->data - 1;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static canary_t* GetPostfixChunkCanary(const SegChunk* chunk)
+{
+    assert(chunk);
+
+    return (canary_t*) (chunk->data + chunk->capacity);
+}
+#endif
+
+//-----------------------------------------------------------------------------------------------------
+
+static int SegCheck(SegStack* seg)
+{
+    assert(seg);
+
+    ON_CANARY
+    (
+        if (seg->seg_prefix != canary_val || seg->seg_postfix != canary_val)
+            seg->status |= STACK_CANARY_TRIGGER
+    );
+
+    ON_HASH
+    (
+        if (seg->hash_func == nullptr)
+        {
+            seg->status |= INVALID_HASH_FUNC;
+            return seg->status;
+        }
+
+        if (CountSegHash(seg) != seg->stack_hash)                   seg->status |= INCORRECT_STACK_HASH
+    );
+
+    if (seg->top == nullptr)
+    {
+        seg->status |= INVALID_DATA;
+        return seg->status;
+    }
+
+    if (seg->top_size > seg->size)                                  seg->status |= INVALID_SIZE;
+
+    // only header of top chunk is checked, its data hash is verified by steps, so check time does not depend on size
+    seg->status |= ChunkCheck(seg, seg->top, seg->top_size, false);
+
+    ON_HASH
+    (
+        if (seg->top_size <= seg->top->capacity && !ScrubTopChunk(seg))
+            seg->status |= INCORRECT_DATA_HASH
+    );
+
+    return seg->status;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static int ChunkCheck(const SegStack* seg, const SegChunk* chunk, const size_t used, const bool full)
+{
+    assert(seg);
+    assert(chunk);
+
+    int condition = OK;
+
+    if (chunk->data == nullptr)
+        return INVALID_DATA;
+
+    if (chunk->capacity == 0)                                       condition |= INVALID_CAPACITY;
+    if (used > chunk->capacity)
+        return condition | INVALID_SIZE;
+
+    ON_CANARY
+    (
+        if (*GetPrefixChunkCanary(chunk) != canary_val || *GetPostfixChunkCanary(chunk) != canary_val)
+            condition |= DATA_CANARY_TRIGGER
+    );
+
+    ON_HASH
+    (
+        if (CountHeaderHash(seg, chunk) != chunk->header_hash)      condition |= INCORRECT_STACK_HASH
+    );
+
+    if (!full)
+        return condition;
+
+    ON_HASH
+    (
+        if (CountDataHash(seg, chunk, used) != chunk->data_hash)    condition |= INCORRECT_DATA_HASH
+    );
+
+    for (size_t i = used; i < chunk->capacity; i++)
+    {
+        if (chunk->data[i] != POISON)
+        {
+            condition |= POISON_ACCESS;
+            break;
+        }
+    }
+
+    return condition;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+__attribute__((cold, noinline))
+static int ReportCorruption(SegStack* seg, const int condition, const char* func, const char* file, const int line)
+{
+    assert(seg);
+
+    seg->status |= condition;
+
+    LogDump(SegStackDump, seg, func, file, line);
+
+    return (int) ERRORS::INVALID_STACK;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void PrintSegCondition(const SegStack* seg)
+{
+    assert(seg);
+
+    PrintLog("\n>>>>>>>>>>STACK CONDITIONS<<<<<<<<<\n");
+
+    if ((seg->status & INVALID_CAPACITY) != 0)
+        PrintLog("INVALID CHUNK CAPACITY\n");
+
+    if ((seg->status & INVALID_SIZE) != 0)
+        PrintLog("INVALID STACK SIZE\n");
+
+    if ((seg->status & INVALID_DATA) != 0)
+        PrintLog("INVALID CHUNK LIST\n");
+
+    if ((seg->status & POISON_ACCESS) != 0)
+        PrintLog("CAN NOT ACCESS TO POISONED ELEMENT\n");
+
+    if ((seg->status & DATA_CANARY_TRIGGER) != 0)
+        PrintLog("CHUNK CANARY TRIGGERED\n");
+
+    if ((seg->status & STACK_CANARY_TRIGGER) != 0)
+        PrintLog("STACK CANARY TRIGGERED\n");
+
+    if ((seg->status & INVALID_HASH_FUNC) != 0)
+        PrintLog("INVALID HASH FUNCTION\n");
+
+    if ((seg->status & INCORRECT_DATA_HASH) != 0)
+        PrintLog("INCORRECT CHUNK DATA HASH\n");
+
+    if ((seg->status & INCORRECT_STACK_HASH) != 0)
+        PrintLog("INCORRECT STACK OR CHUNK HEADER HASH\n");
+
+    PrintLog(">>>>>>>>STACK CONDITIONS END<<<<<<<\n\n");
+}
@@ -0,0 +1,152 @@
+#ifndef __SEG_STACK_H_
+#define __SEG_STACK_H_
+
+#include <stdio.h>
+
+#include "stack.h"
+
+/*! \file
+* \brief Contains segmented stack: linked list of chunks instead of one buffer
+*
+* Full top chunk gets new chunk above it (capacities grow twice up to max_chunk), so push never copies elements,
+* and its worst case is one chunk allocation. Chunk, that becomes empty, is kept in one-chunk cache, so stack,
+* that pushes and pops at chunk border, does not allocate. Every chunk has its own data canaries, header hash and
+* data hash. Operations check stack header, header of top chunk and slot, that they touch, and fold HASH_SCRUB_STEP
+* slots of top chunk into its data hash verification, so check time does not depend on size or chunk capacity.
+* SegStackOk checks all chunks.
+*/
+
+/// default capacity of first chunk
+static const size_t SEG_MIN_CHUNK = 256;
+/// default capacity, to which chunk capacities grow
+static const size_t SEG_MAX_CHUNK = 1 << 16;
+
+/// @brief chunk of segmented stack (elements are placed after it, between data canaries)
+struct SegChunk
+{
+    /// chunk below this one (nullptr for first chunk)
+    SegChunk* prev;
+    /// capacity
+    size_t capacity;
+    /// elements
+    elem_t* data;
+
+    ON_HASH
+    (
+        /// hash of prev, capacity and data
+        hash_t header_hash;
+        /// xor of position-aware hashes of elements (empty slots are not hashed)
+        hash_t data_hash;
+    )
+};
+
+/// @brief segmented stack
+struct SegStack
+{
+    ON_CANARY
+    (
+        /// stack prefix canary
+        canary_t seg_prefix;
+    )
+
+    /// chunk allocator (can be set before SegStackCtor, MALLOC_ALLOCATOR by default)
+    const StackAllocator* allocator;
+
+    /// chunk with top element
+    SegChunk* top;
+    /// empty chunk, that was released last (it is taken by next growth)
+    SegChunk* cache;
+    /// amount of elements
+    size_t size;
+    /// amount of elements in top chunk
+    size_t top_size;
+    /// amount of chunks in list
+    size_t chunks;
+    /// capacity of first chunk
+    size_t min_chunk;
+    /// largest chunk capacity
+    size_t max_chunk;
+    /// stack status (0 if everything is fine)
+    int status;
+
+    /// chunks, that were taken from allocator
+    size_t chunk_allocs;
+    /// chunks, that were taken from cache
+    size_t cache_hits;
+
+    ON_HASH
+    (
+        /// hash function (can be set before SegStackCtor)
+        hash_f hash_func;
+        /// stack hash
+        hash_t stack_hash;
+        /// next slot of top chunk to be folded into scrub_acc by data hash verification
+        size_t scrub_pos;
+        /// data hash of slots [0, scrub_pos) of top chunk, as seen by verification
+        hash_t scrub_acc;
+    )
+
+    ON_CANARY
+    (
+        /// stack postfix canary
+        canary_t seg_postfix;
+    )
+};
+
+/************************************************************//**
+ * @brief Creates segmented stack with its first chunk
+ *
+ * @param[in] seg stack pointer
+ * @param[in] min_chunk capacity of first chunk
+ * @param[in] max_chunk capacity, to which chunk capacities grow (min_chunk for chunks of one capacity)
+ * @return int error code
+ ************************************************************/
+int SegStackCtor(SegStack* seg, size_t min_chunk = SEG_MIN_CHUNK, size_t max_chunk = SEG_MAX_CHUNK);
+
+/************************************************************//**
+ * @brief Destroys segmented stack (all chunks and cache are freed)
+ *
+ * @param[in] seg stack pointer
+ * @return int error code
+ ************************************************************/
+int SegStackDtor(SegStack* seg);
+
+/************************************************************//**
+ * @brief Pushes element in segmented stack
+ *
+ * @param[in] seg stack pointer
+ * @param[in] value element
+ * @return int error code
+ ************************************************************/
+int SegStackPush(SegStack* seg, elem_t value);
+
+/************************************************************//**
+ * @brief Pops element from segmented stack
+ *
+ * @param[in] seg stack pointer
+ * @param[out] ret_value popped element
+ * @return int error code
+ ************************************************************/
+int SegStackPop(SegStack* seg, elem_t* ret_value);
+
+/************************************************************//**
+ * @brief Prints info about segmented stack and its chunks in output stream
+ *
+ * @param[in] fp output stream
+ * @param[in] seg stack pointer
+ * @param[in] func function, where print called
+ * @param[in] file file, where print called
+ * @param[in] line line, where print caled
+ * @return int error code
+ ************************************************************/
+int SegStackDump(FILE* fp, const void* seg, const char* func, const char* file, const int line);
+
+/************************************************************//**
+ * @brief Verifies segmented stack (canaries, hashes and poison of every chunk and cache)
+ *
+ * @param[in] seg stack pointer
+ * @return int stack condition code
+ ************************************************************/
+int SegStackOk(const SegStack* seg);
+
+#endif
@@ -0,0 +1,310 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "sharded_stack.h"
+#include "log_funcs.h"
+#include "hash.h"
+
+// ============= STATIC FUNCS ===============
+static Magazine* NewMagazine(ShardedStack* sstk);
+static Magazine* TakeMagazine(ConcurrentStack* depot);
+static int PutMagazine(ConcurrentStack* depot, Magazine* magazine);
+static void FreeMagazines(ConcurrentStack* depot);
+
+static int FlushMagazine(StackShard* shard, const size_t count);
+static int LoadMagazine(StackShard* shard);
+
+static void SealMagazine(Magazine* magazine);
+static int VerifyMagazine(const Magazine* magazine);
+//============================================
+
+// =============CONSTS============
+static const canary_t canary_val = STACK_CANARY;
+// ===============================
+
+int ShardedStackCtor(ShardedStack* sstk)
+{
+    assert(sstk);
+
+    sstk->magazines.store(0, std::memory_order_relaxed);
+
+    int error = ConcurrentStackCtor(&sstk->full);
+
+    if (error != (int) ERRORS::NONE)
+        return error;
+
+    return ConcurrentStackCtor(&sstk->empty);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int ShardedStackDtor(ShardedStack* sstk)
+{
+    assert(sstk);
+
+    FreeMagazines(&sstk->full);
+    FreeMagazines(&sstk->empty);
+
+    ConcurrentStackDtor(&sstk->full);
+    ConcurrentStackDtor(&sstk->empty);
+
+    sstk->magazines.store(0, std::memory_order_relaxed);
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int StackShardCtor(StackShard* shard, ShardedStack* sstk)
+{
+    assert(shard);
+    assert(sstk);
+
+    shard->owner = sstk;
+
+    // shard never has more than 2 * MAGAZINE_SIZE elements, so it keeps its buffer
+    shard->stk.growth.never_shrink = true;
+
+    return StackCtor(&shard->stk, 2 * MAGAZINE_SIZE);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int StackShardDtor(StackShard* shard)
+{
+    assert(shard);
+
+    while (shard->stk.size != 0)
+    {
+        size_t count = (shard->stk.size < MAGAZINE_SIZE) ? shard->stk.size : MAGAZINE_SIZE;
+
+        int error = FlushMagazine(shard, count);
+
+        if (error != (int) ERRORS::NONE)
+            return error;
+    }
+
+    return StackDtor(&shard->stk);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int ShardPush(StackShard* shard, elem_t value)
+{
+    assert(shard);
+
+    int error = StackPush(&shard->stk, value);
+
+    if (error != (int) ERRORS::NONE)
+        return error;
+
+    if (shard->stk.size >= 2 * MAGAZINE_SIZE)
+        return FlushMagazine(shard, MAGAZINE_SIZE);
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int ShardPop(StackShard* shard, elem_t* ret_value)
+{
+    assert(shard);
+    assert(ret_value);
+
+    if (shard->stk.size == 0)
+    {
+        int error = LoadMagazine(shard);
+
+        if (error != (int) ERRORS::NONE)
+            return error;
+    }
+
+    return StackPop(&shard->stk, ret_value);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int ShardedStackDump(FILE* fp, const void* stack, const char* func, const char* file, const int line)
+{
+    assert(stack);
+    assert(func);
+    assert(file);
+
+    const ShardedStack* sstk = (const ShardedStack*) stack;
+
+    LOG_START_MOD(func, file, line);
+
+    fprintf(fp, "ShardedStack         > [%p]\n"
+                "magazine size        > %zu\n"
+                "magazines            > %zu\n"
+                "full magazines       > [%p]\n"
+                "empty magazines      > [%p]\n",
+                sstk, MAGAZINE_SIZE, sstk->magazines.load(std::memory_order_relaxed),
+                &sstk->full, &sstk->empty);
+
+    LOG_END();
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static int FlushMagazine(StackShard* shard, const size_t count)
+{
+    assert(shard);
+    assert(count <= MAGAZINE_SIZE);
+
+    Magazine* magazine = NewMagazine(shard->owner);
+
+    if (magazine == nullptr)
+        return (int) ERRORS::ALLOCATE_MEMORY;
+
+    int error = StackPopN(&shard->stk, magazine->data, count);
+
+    if (error != (int) ERRORS::NONE)
+    {
+        PutMagazine(&shard->owner->empty, magazine);
+        return error;
+    }
+
+    magazine->count = count;
+    SealMagazine(magazine);
+
+    return PutMagazine(&shard->owner->full, magazine);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static int LoadMagazine(StackShard* shard)
+{
+    assert(shard);
+
+    Magazine* magazine = TakeMagazine(&shard->owner->full);
+
+    if (magazine == nullptr)
+        return (int) ERRORS::EMPTY_STACK;
+
+    int condition = VerifyMagazine(magazine);
+
+    if (condition != OK)
+    {
+        PrintLog("BROKEN MAGAZINE [%p] (CONDITION %d) IN SHARDED STACK [%p]\n", magazine, condition, shard->owner);
+
+        // broken magazine is not returned to depot
+        free(magazine);
+        shard->owner->magazines.fetch_sub(1, std::memory_order_relaxed);
+
+        LogDump(ShardedStackDump, shard->owner, __func__, __FILE__, __LINE__);
+
+        return (int) ERRORS::INVALID_STACK;
+    }
+
+    int error = StackPushN(&shard->stk, magazine->data, magazine->count);
+
+    magazine->count = 0;
+    PutMagazine(&shard->owner->empty, magazine);
+
+    return error;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static Magazine* NewMagazine(ShardedStack* sstk)
+{
+    assert(sstk);
+
+    Magazine* magazine = TakeMagazine(&sstk->empty);
+
+    if (magazine != nullptr)
+        return magazine;
+
+    magazine = (Magazine*) calloc(1, sizeof(Magazine));
+
+    if (magazine == nullptr)
+        return nullptr;
+
+    ON_CANARY
+    (
+        magazine->prefix  = canary_val;
+        magazine->postfix = canary_val
+    );
+
+    sstk->magazines.fetch_add(1, std::memory_order_relaxed);
+
+    return magazine;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static Magazine* TakeMagazine(ConcurrentStack* depot)
+{
+    assert(depot);
+
+    elem_t handle = 0;
+
+    if (ConcurrentStackPop(depot, &handle) != (int) ERRORS::NONE)
+        return nullptr;
+
+    return (Magazine*) (intptr_t) handle;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static int PutMagazine(ConcurrentStack* depot, Magazine* magazine)
+{
+    assert(depot);
+    assert(magazine);
+
+    return ConcurrentStackPush(depot, (elem_t) (intptr_t) magazine);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void FreeMagazines(ConcurrentStack* depot)
+{
+    assert(depot);
+
+    Magazine* magazine = nullptr;
+
+    while ((magazine = TakeMagazine(depot)) != nullptr)
+        free(magazine);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void SealMagazine(Magazine* magazine)
+{
+    assert(magazine);
+
+    ON_HASH
+    (
+        // count and data are adjacent
+        magazine->hash = MurmurHash(&magazine->count, sizeof(size_t) + magazine->count * sizeof(elem_t))
+    );
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static int VerifyMagazine(const Magazine* magazine)
+{
+    assert(magazine);
+
+    int condition = OK;
+
+    ON_CANARY
+    (
+        if (magazine->prefix != canary_val || magazine->postfix != canary_val) condition |= DATA_CANARY_TRIGGER
+    );
+
+    if (magazine->count > MAGAZINE_SIZE)
+        return condition | INVALID_SIZE;
+
+    ON_HASH
+    (
+        if (magazine->hash != MurmurHash(&magazine->count, sizeof(size_t) + magazine->count * sizeof(elem_t)))
+            condition |= INCORRECT_DATA_HASH
+    );
+
+    return condition;
+}
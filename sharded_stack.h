@@ -0,0 +1,133 @@
+#ifndef __SHARDED_STACK_H_
+#define __SHARDED_STACK_H_
+
+#include <stdio.h>
+#include <atomic>
+
+#include "stack.h"
+#include "concurrent_stack.h"
+
+/*! \file
+* \brief Contains sharded stack: thread shards and shared depot of element magazines
+*
+* Every thread works with its own shard (usual Stack with all its checks). Shard, that has 2 * MAGAZINE_SIZE
+* elements, moves MAGAZINE_SIZE of them into magazine and pushes it to depot, empty shard takes full magazine
+* from depot. Depot is a pair of lock-free stacks (full and empty magazines), so every transfer is one
+* lock-free operation and threads touch shared memory only once per MAGAZINE_SIZE operations.
+* Elements have no order across threads.
+*/
+
+/// amount of elements in magazine
+static const size_t MAGAZINE_SIZE = 64;
+
+/// @brief batch of elements, that is moved between shard and depot
+struct Magazine
+{
+    ON_CANARY
+    (
+        /// magazine prefix canary
+        canary_t prefix;
+    )
+
+    /// amount of elements
+    size_t count;
+    /// elements
+    elem_t data[MAGAZINE_SIZE];
+
+    ON_HASH
+    (
+        /// hash of count and elements
+        hash_t hash;
+    )
+
+    ON_CANARY
+    (
+        /// magazine postfix canary
+        canary_t postfix;
+    )
+};
+
+/// @brief shared part of sharded stack
+struct ShardedStack
+{
+    /// full magazines
+    ConcurrentStack full;
+    /// empty magazines
+    ConcurrentStack empty;
+    /// allocated magazines
+    std::atomic<size_t> magazines;
+};
+
+/// @brief thread shard of sharded stack (only its thread may use it)
+struct StackShard
+{
+    /// sharded stack
+    ShardedStack* owner;
+    /// thread elements (its fields can be set before StackShardCtor like before StackCtor)
+    Stack_t stk;
+};
+
+/************************************************************//**
+ * @brief Creates sharded stack
+ *
+ * @param[in] sstk sharded stack pointer
+ * @return int error code
+ ************************************************************/
+int ShardedStackCtor(ShardedStack* sstk);
+
+/************************************************************//**
+ * @brief Destroys sharded stack (all shards must be destroyed before)
+ *
+ * @param[in] sstk sharded stack pointer
+ * @return int error code
+ ************************************************************/
+int ShardedStackDtor(ShardedStack* sstk);
+
+/************************************************************//**
+ * @brief Creates thread shard of sharded stack
+ *
+ * @param[in] shard shard pointer
+ * @param[in] sstk sharded stack pointer
+ * @return int error code
+ ************************************************************/
+int StackShardCtor(StackShard* shard, ShardedStack* sstk);
+
+/************************************************************//**
+ * @brief Destroys thread shard, its elements go to depot
+ *
+ * @param[in] shard shard pointer
+ * @return int error code
+ ************************************************************/
+int StackShardDtor(StackShard* shard);
+
+/************************************************************//**
+ * @brief Pushes element in thread shard (full magazine goes to depot)
+ *
+ * @param[in] shard shard pointer
+ * @param[in] value element
+ * @return int error code
+ ************************************************************/
+int ShardPush(StackShard* shard, elem_t value);
+
+/************************************************************//**
+ * @brief Pops element from thread shard (empty shard takes magazine from depot)
+ *
+ * @param[in] shard shard pointer
+ * @param[out] ret_value popped element
+ * @return int error code (ERRORS::EMPTY_STACK, if shard and depot are empty)
+ ************************************************************/
+int ShardPop(StackShard* shard, elem_t* ret_value);
+
+/************************************************************//**
+ * @brief Prints info about sharded stack in output stream
+ *
+ * @param[in] fp output stream
+ * @param[in] sstk sharded stack pointer
+ * @param[in] func function, where print called
+ * @param[in] file file, where print called
+ * @param[in] line line, where print caled
+ * @return int error code
+ ************************************************************/
+int ShardedStackDump(FILE* fp, const void* sstk, const char* func, const char* file, const int line);
+
+#endif
@@ -1,9 +1,71 @@
 #include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
 #include <assert.h>
+#include <stdint.h>
+#include <time.h>
+#include <inttypes.h>
 
 #include "stack.h"
 #include "log_funcs.h"
 #include "hash.h"
+#include "poison.h"
+#include "stack_dump.h"
+#include "guard_pages.h"
+#include "stack_verifier.h"
+#include "stack_stats.h"
+
+/// @brief place of check in stack operation
+enum CheckPoint
+{
+    /// beginning of operation
+    CHECK_ENTRY,
+    /// inside of operation (for example, in StackRealloc)
+    CHECK_INNER,
+    /// end of operation
+    CHECK_EXIT
+};
+
+/// @brief what stack check verifies
+enum CheckDepth
+{
+    /// stack canaries and stack hash
+    DEPTH_HEADER,
+    /// everything, data hash is verified by HASH_SCRUB_STEP slots per check
+    DEPTH_STEP,
+    /// everything, data hash is recounted over whole buffer
+    DEPTH_FULL
+};
+
+/// @brief write section of stack operation: write sequence of stack is odd, while section is alive,
+/// so background verifier does not copy stack in the middle of change (nested sections do nothing)
+struct WriteSection
+{
+    /// stack
+    Stack_t* stk;
+    /// section is not nested
+    bool outer;
+
+    explicit WriteSection(Stack_t* stack) :
+        stk(stack),
+        outer((__atomic_load_n(&stack->write_seq, __ATOMIC_RELAXED) & 1) == 0)
+    {
+        if (!outer)
+            return;
+
+        __atomic_store_n(&stk->write_seq, stk->write_seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+
+    ~WriteSection()
+    {
+        if (outer)
+            __atomic_store_n(&stk->write_seq, stk->write_seq + 1, __ATOMIC_RELEASE);
+    }
+
+    WriteSection(const WriteSection&)            = delete;
+    WriteSection& operator=(const WriteSection&) = delete;
+};
 
 // ============= STATIC FUNCS ===============
 static inline bool EmptyStackCheck(Stack_t* stk);
@@ -14,21 +76,66 @@ static canary_t* GetPostfixDataCanary(const Stack_t* stk);
 static canary_t* GetPrefixDataCanary(const Stack_t* stk);
 
 static size_t CountDataSize(const size_t capacity);
+static size_t FitCapacity(const Stack_t* stk, size_t capacity);
+static inline bool IsInline(const size_t capacity);
+static elem_t* GetInlineBlock(Stack_t* stk);
+static void* ResizeBlock(Stack_t* stk, void* block, const size_t old_capacity, const size_t new_capacity);
+static void CopyStackHeader(Stack_t* dest, const Stack_t* src);
+static void WatchData(const Stack_t* stk, const void* block, const size_t size);
+static void AttachBlock(Stack_t* stk, void* block);
+static void RegisterStack(Stack_t* stk);
+static inline bool SameWriteSeq(const Stack_t* stk, const unsigned int seq);
+
+#if STACK_STATS
+static inline uint64_t CountTime(const StatsCounter counter, const StatsCounter time_counter, const uint64_t start);
+static void CountDump(const Stack_t* stk, const uint64_t start);
+#endif
 
 static hash_t GetDataHash(const Stack_t* stk);
 static hash_t GetStackHash(const Stack_t* stk);
 static bool VerifyDataHash(const Stack_t* stk);
 static bool VerifyStackHash(const Stack_t* stk);
-static inline void ReInitAllHashes(Stack_t* stk);
+static inline void ReInitStackHash(Stack_t* stk);
+static void InitDataHash(Stack_t* stk);
+static inline void WriteSlot(Stack_t* stk, const size_t index, const elem_t old_value, const elem_t new_value);
+#if HASH_PROTECT
+static hash_t CountStackHash(const Stack_t* stk, hash_f hash_func);
+static bool ScrubDataHash(Stack_t* stk);
+static void ResizeDataHash(Stack_t* stk, const size_t old_capacity, const size_t new_capacity);
+static inline hash_t SlotHash(const Stack_t* stk, const size_t index, const elem_t value);
+static void HashSlots(Stack_t* stk, const size_t first, const elem_t* values, const size_t count);
+static void HashPoisonedSlots(Stack_t* stk, const size_t first, const size_t count);
+#endif
 
 static int StackRealloc(Stack_t* stk, size_t new_capacity);
-
-static inline bool IsStackValid(Stack* stack, const char* func, const char* file, const int line);
+static void InitGrowthPolicy(GrowthPolicy* growth);
+static void UpdateFastLimits(Stack_t* stk);
+static size_t GrowCapacity(const Stack_t* stk, const size_t min_capacity);
+static size_t ShrinkCapacity(const Stack_t* stk);
+static bool NeedShrink(const Stack_t* stk);
+static inline void CountInlineOps(Stack_t* stk);
+static inline void CountOperation(Stack_t* stk);
+
+static int StackCheck(Stack_t* stk, const CheckDepth depth);
+static bool NeedCheck(Stack_t* stk, const CheckPoint point);
+static inline bool IsStackValid(Stack* stack, const CheckPoint point,
+                                const char* func, const char* file, const int line);
+static void ReportInvalidStack(const Stack_t* stk, const char* func, const char* file, const int line);
+static void ReportEmptyPop(Stack_t* stk, const char* func, const char* file, const int line);
 static void PrintStackCondition(const Stack_t* stk);
 static int PrintStackData(FILE* fp, const Stack_t* stk);
+static int WriteDumpRecord(FILE* fp, const Stack_t* stk, const char* func, const char* file, const int line,
+                           long* offset);
 
 static void PoisonData(elem_t* left_border, elem_t* right_border);
-static bool PoisonVerify(Stack_t* stk);
+#if SANITIZER_POISON
+static void UnpoisonData(elem_t* left_border, elem_t* right_border);
+#endif
+static inline elem_t ReadSlot(const Stack_t* stk, const size_t index);
+static bool PoisonVerify(const Stack_t* stk);
+static bool PoisonVerifyRange(const Stack_t* stk, size_t left, size_t right);
+static bool PoisonVerifyStep(Stack_t* stk);
+static inline void MarkPoisonDirty(Stack_t* stk, const size_t left, const size_t right);
 
 static bool Equal(const elem_t a, const elem_t b);
 //============================================
@@ -37,28 +144,51 @@ static bool Equal(const elem_t a, const elem_t b);
 #undef CHECK_STACK
 
 #endif
-#define CHECK_STACK(stk)    do                                                          \
-                            {                                                           \
-                                if (!IsStackValid(stk, __func__, __FILE__, __LINE__))   \
-                                    return (int) ERRORS::INVALID_STACK;                 \
-                            } while(0)
+#define CHECK_STACK(stk, point)     do                                                              \
+                                    {                                                               \
+                                        if (!IsStackValid(stk, point, __func__, __FILE__, __LINE__))\
+                                            return (int) ERRORS::INVALID_STACK;                     \
+                                    } while(0)
 
 // =============CONSTS============
-static const canary_t canary_val = 0xD07ADEAD;
-static const elem_t POISON       = -123456789;
+static const canary_t canary_val = STACK_CANARY;
+static const elem_t POISON       = STACK_POISON;
+
+/// capacity, below which stack does not shrink (inline capacity, if it is smaller than MIN_CAPACITY)
+static const size_t LEAST_CAPACITY = (STACK_INLINE_CAPACITY != 0 && STACK_INLINE_CAPACITY < MIN_CAPACITY) ?
+                                     STACK_INLINE_CAPACITY : MIN_CAPACITY;
 // ===============================
 
 int StackCtor(Stack_t* stk, size_t capacity)
 {
     assert(stk);
 
+    if (stk->allocator == nullptr)
+        stk->allocator = (GUARD_PAGE_PROTECT) ? &GUARD_ALLOCATOR : &MALLOC_ALLOCATOR;
+
+    stk->write_seq     = 0;
+    stk->registry_slot = 0;
+
+    // stack of fixed capacity never allocates
+    if (STACK_FIXED_CAPACITY && capacity > STACK_INLINE_CAPACITY)
+        return (int) ERRORS::ALLOCATE_MEMORY;
+
+    capacity = FitCapacity(stk, capacity);
+
     elem_t* data       = nullptr;
     size_t data_size   = CountDataSize(capacity);
 
-    data = (elem_t*) calloc(data_size, 1);
+    if (IsInline(capacity))
+        data = GetInlineBlock(stk);
+    else
+    {
+        data = (elem_t*) stk->allocator->alloc(stk->allocator->ctx, data_size);
 
-    if (data == nullptr)
-        return (int) ERRORS::ALLOCATE_MEMORY;
+        if (data == nullptr)
+            return (int) ERRORS::ALLOCATE_MEMORY;
+
+        WatchData(stk, data, data_size);
+    }
 
     elem_t* first_elem = data;
 
@@ -77,6 +207,19 @@ int StackCtor(Stack_t* stk, size_t capacity)
     stk->size     = 0;
     stk->capacity = capacity;
     stk->status   = OK;
+    stk->stats    = {};
+
+    stk->poison_dirty_left  = 0;
+    stk->poison_dirty_right = 0;
+    stk->poison_scrub_pos   = 0;
+
+    if (stk->verify_period == 0)
+        stk->verify_period = DEFAULT_VERIFY_PERIOD;
+
+    InitGrowthPolicy(&stk->growth);
+    UpdateFastLimits(stk);
+    stk->ops_since_realloc = 0;
+    stk->fast_size_mark    = stk->size;
 
     PoisonData(stk->data, (elem_t*)((char*)stk->data + stk->capacity * sizeof(elem_t)));
 
@@ -86,9 +229,12 @@ int StackCtor(Stack_t* stk, size_t capacity)
             stk->hash_func = MurmurHash
     );
 
-    ReInitAllHashes(stk);
+    InitDataHash(stk);
+    ReInitStackHash(stk);
+
+    CHECK_STACK(stk, CHECK_EXIT);
 
-    CHECK_STACK(stk);
+    RegisterStack(stk);
 
     return (int) ERRORS::NONE;
 }
@@ -99,19 +245,35 @@ int StackDtor(Stack_t* stk)
 {
     assert(stk);
 
-    CHECK_STACK(stk);
+    WriteSection section(stk);
+
+    // verifier does not copy stack after that, so buffer can be freed (stack is removed even if it is corrupted)
+    StackRegistryRemove(stk);
+
+    CHECK_STACK(stk, CHECK_ENTRY);
 
     OFF_CANARY(elem_t* data = stk->data);
 
     ON_CANARY(elem_t* data = (elem_t*)((char*) stk->data - sizeof(canary_t)));
 
-    free(data);
+    // allocator may write to freed block (and inline block is memory of its owner), so it gets accessible
+    ON_SAN_POISON(UnpoisonData(stk->data + stk->size, stk->data + stk->capacity));
+
+    if (!IsInline(stk->capacity))
+    {
+        if (stk->allocator == &GUARD_ALLOCATOR)
+            GuardPagesUnwatch(stk);
+
+        stk->allocator->free(stk->allocator->ctx, data, CountDataSize(stk->capacity));
+    }
 
     stk->data     = nullptr;
     stk->size     = 0;
     stk->capacity = 0;
     stk->status   = OK;
 
+    UpdateFastLimits(stk);
+
     ON_CANARY
     (
         stk->stack_prefix  = 0;
@@ -120,9 +282,11 @@ int StackDtor(Stack_t* stk)
 
     ON_HASH
     (
-        stk->hash_func  = nullptr;
-        stk->stack_hash = 0;
-        stk->data_hash  = 0
+        stk->hash_func      = nullptr;
+        stk->stack_hash     = 0;
+        stk->data_hash      = 0;
+        stk->hash_scrub_pos = 0;
+        stk->hash_scrub_acc = 0
     );
 
     return (int) ERRORS::NONE;
@@ -130,49 +294,85 @@ int StackDtor(Stack_t* stk)
 
 //-----------------------------------------------------------------------------------------------------
 
-int StackPush(Stack_t* stk, elem_t value)
+int StackPushSlow(Stack_t* stk, elem_t value)
 {
     assert(stk);
     assert(stk->data);
 
-    CHECK_STACK(stk);
+    WriteSection section(stk);
+    CountInlineOps(stk);
+
+    ON_STATS(uint64_t start = SampleTicks(stk->stats.pushes));
+
+    CHECK_STACK(stk, CHECK_ENTRY);
 
     if (stk->capacity == stk->size)
     {
-        if (StackRealloc(stk, stk->capacity << 1) != (int) ERRORS::NONE)
-            return (int) ERRORS::ALLOCATE_MEMORY;
+        int realloc_error  = StackRealloc(stk, GrowCapacity(stk, stk->size + 1));
+        if (realloc_error != (int) ERRORS::NONE)
+            return realloc_error;
     }
 
-    (stk->data)[(stk->size)++] = value;
+    ON_SAN_POISON(UnpoisonData(stk->data + stk->size, stk->data + stk->size + 1));
+
+    WriteSlot(stk, (stk->size)++, POISON, value);
+    CountOperation(stk);
+
+    ReInitStackHash(stk);
 
-    ReInitAllHashes(stk);
+    CHECK_STACK(stk, CHECK_EXIT);
 
-    CHECK_STACK(stk);
+    ON_STATS
+    (
+        stk->stats.pushes++;
+        StatsRecord(STATS_PUSH, start)
+    );
 
     return (int) ERRORS::NONE;
 }
 
 //-----------------------------------------------------------------------------------------------------
 
+__attribute__((cold, noinline))
 static int StackRealloc(Stack_t* stk, size_t new_capacity)
 {
     assert(stk);
 
-    CHECK_STACK(stk);
+    CHECK_STACK(stk, CHECK_INNER);
 
-    if (new_capacity < MIN_CAPACITY)
-        new_capacity = MIN_CAPACITY;
+    // stack keeps its data, as it can not grow out of inline block
+    if (STACK_FIXED_CAPACITY && new_capacity > STACK_INLINE_CAPACITY)
+        return (int) ERRORS::FULL_STACK;
 
-    elem_t* data       = stk->data;
-    elem_t* first_elem = data;
-    size_t new_size    = CountDataSize(new_capacity);
+    if (new_capacity < LEAST_CAPACITY)
+        new_capacity = LEAST_CAPACITY;
+
+    new_capacity = FitCapacity(stk, new_capacity);
+
+    if (new_capacity == stk->capacity)
+        return (int) ERRORS::NONE;
+
+    ON_STATS(uint64_t start = ReadTicks());
+
+    elem_t* data        = stk->data;
+    elem_t* first_elem  = data;
+    size_t new_size     = CountDataSize(new_capacity);
+    size_t old_capacity = stk->capacity;
 
     ON_CANARY
     (
         data = (elem_t*)((char*) data - sizeof(canary_t))
     );
 
-    elem_t* temp = (elem_t*) realloc(data, new_size);
+    // realloc copies whole block, so empty slots become accessible until it is done
+    ON_SAN_POISON(UnpoisonData(stk->data + stk->size, stk->data + old_capacity));
+
+    // old buffer can be freed, so verifier must not copy it
+    bool held = VerifierHold();
+
+    elem_t* temp = (elem_t*) ResizeBlock(stk, data, old_capacity, new_capacity);
+
+    VerifierRelease(held);
 
     if (temp == nullptr)
     {
@@ -180,8 +380,21 @@ static int StackRealloc(Stack_t* stk, size_t new_capacity)
 
         return (int) ERRORS::ALLOCATE_MEMORY;
     }
-    else
-        data = temp;
+
+    stk->stats.reallocs++;
+    if (temp != data)
+    {
+        size_t copied = CountDataSize(old_capacity < new_capacity ? old_capacity : new_capacity);
+
+        stk->stats.bytes_copied += copied;
+        ON_STATS(StatsAdd(STATS_BYTES_COPIED, copied));
+    }
+
+    data       = temp;
+    first_elem = data;
+
+    if (!IsInline(new_capacity))
+        WatchData(stk, data, new_size);
 
     ON_CANARY
     (
@@ -191,307 +404,1225 @@ static int StackRealloc(Stack_t* stk, size_t new_capacity)
         *(postfix_canary) = canary_val
     );
 
-    stk->data     = first_elem;
-    stk->capacity = new_capacity;
+    stk->data              = first_elem;
+    stk->capacity          = new_capacity;
+    stk->ops_since_realloc = 0;
+
+    UpdateFastLimits(stk);
+
+    ON_SAN_POISON(PoisonData(stk->data + stk->size, stk->data + new_capacity));
 
-    PoisonData((elem_t*)((char*)stk->data + stk->size * sizeof(elem_t)),
-               (elem_t*)((char*)stk->data + stk->capacity * sizeof(elem_t)));
+    // slots, that were kept by realloc, are already poisoned
+    OFF_SAN_POISON
+    (
+        if (new_capacity > old_capacity)
+            PoisonData((elem_t*)((char*)stk->data + old_capacity * sizeof(elem_t)),
+                       (elem_t*)((char*)stk->data + new_capacity * sizeof(elem_t)))
+    );
 
-    ReInitAllHashes(stk);
+    ON_HASH(ResizeDataHash(stk, old_capacity, new_capacity));
+    ReInitStackHash(stk);
 
-    CHECK_STACK(stk);
+    ON_STATS(stk->stats.realloc_ticks += CountTime(STATS_REALLOCS, STATS_REALLOC_NS, start));
+
+    CHECK_STACK(stk, CHECK_INNER);
 
     return (int) ERRORS::NONE;
 }
 
 //-----------------------------------------------------------------------------------------------------
 
-int StackPop(Stack_t* stk, elem_t* ret_value)
+int StackPopSlow(Stack_t* stk, elem_t* ret_value)
 {
     assert(stk);
     assert(stk->data);
 
+    WriteSection section(stk);
+    CountInlineOps(stk);
+
+    ON_STATS(uint64_t start = SampleTicks(stk->stats.pops));
+
     if (EmptyStackCheck(stk))
     {
-        stk->status |= EMPTY_STACK;
-        STACK_DUMP(stk);
+        ReportEmptyPop(stk, __func__, __FILE__, __LINE__);
         return (int) ERRORS::INVALID_STACK;
     }
 
-    CHECK_STACK(stk);
+    CHECK_STACK(stk, CHECK_ENTRY);
 
-    *(ret_value) = (stk->data)[--(stk->size)];
-    (stk->data)[(stk->size)] = POISON;
+    elem_t value = (stk->data)[stk->size - 1];
+    WriteSlot(stk, --(stk->size), value, POISON);
+    ON_SAN_POISON(PoisonData(stk->data + stk->size, stk->data + stk->size + 1));
+    MarkPoisonDirty(stk, stk->size, stk->size + 1);
+    *(ret_value) = value;
+    CountOperation(stk);
 
-    if (stk->size <= stk->capacity >> 2)
+    if (NeedShrink(stk))
     {
-        ReInitAllHashes(stk);
-        int realloc_error  = StackRealloc(stk, stk->capacity >> 1);
+        ReInitStackHash(stk);
+        int realloc_error  = StackRealloc(stk, ShrinkCapacity(stk));
         if (realloc_error != (int) ERRORS::NONE)
             return realloc_error;
     }
 
-    ReInitAllHashes(stk);
+    ReInitStackHash(stk);
+
+    CHECK_STACK(stk, CHECK_EXIT);
 
-    CHECK_STACK(stk);
+    ON_STATS
+    (
+        stk->stats.pops++;
+        StatsRecord(STATS_POP, start)
+    );
 
     return (int) ERRORS::NONE;
 }
 
 //-----------------------------------------------------------------------------------------------------
 
-int StackOk(const Stack_t* stack)
+int StackPushN(Stack_t* stk, const elem_t* values, size_t count)
 {
-    assert(stack);
+    assert(stk);
+    assert(stk->data);
+    assert(values);
 
-#pragma GCC diagnostic ignored "-Wcast-qual"
-    Stack_t* stk = (Stack_t*) stack;
-#pragma GCC diagnostic warning "-Wcast-qual"
+    WriteSection section(stk);
+    CountInlineOps(stk);
 
-    ON_CANARY
-    (
-        canary_t* prefix_canary  = GetPrefixDataCanary(stk);
-        canary_t* postfix_canary = GetPostfixDataCanary(stk);
+    CHECK_STACK(stk, CHECK_ENTRY);
 
-        if (!VerifyCanary(prefix_canary, postfix_canary))           stk->status |= DATA_CANARY_TRIGGER;
-        if (!VerifyCanary(&stk->stack_prefix, &stk->stack_postfix)) stk->status |= DATA_CANARY_TRIGGER
-    );
+    if (count == 0)
+        return (int) ERRORS::NONE;
 
-    if (stk->capacity <= 0)                                         stk->status |= INVALID_CAPACITY;
-    if (stk->size > stk->capacity)                                  stk->status |= INVALID_SIZE;
-    if (stk->data == nullptr && stk->capacity != 0)                 stk->status |= INVALID_DATA;
-#pragma GCC diagnostic ignored "-Wcast-qual"
-    if (!PoisonVerify((Stack_t*) stk))                              stk->status |= POISON_ACCESS;
-#pragma GCC diagnostic warning "-Wcast-qual"
+    if (stk->capacity - stk->size < count)
+    {
+        int realloc_error  = StackRealloc(stk, GrowCapacity(stk, stk->size + count));
+        if (realloc_error != (int) ERRORS::NONE)
+            return realloc_error;
+    }
 
     ON_HASH
     (
-        if (!stk->hash_func)                                        stk->status |= INVALID_HASH_FUNC;
-
-        if (!VerifyDataHash(stk))                                   stk->status |= INCORRECT_DATA_HASH;
-        if (!VerifyStackHash(stk))                                  stk->status |= INCORRECT_STACK_HASH
+        HashPoisonedSlots(stk, stk->size, count);
+        HashSlots(stk, stk->size, values, count)
     );
 
-    return stk->status;
-}
+    ON_SAN_POISON(UnpoisonData(stk->data + stk->size, stk->data + stk->size + count));
 
-//-----------------------------------------------------------------------------------------------------
+    memcpy(stk->data + stk->size, values, count * sizeof(elem_t));
 
-static void InitCanary(canary_t* prefix_canary, canary_t* postfix_canary)
-{
-    assert(prefix_canary);
-    assert(postfix_canary);
-    assert(prefix_canary != postfix_canary);
+    stk->size += count;
+    CountOperation(stk);
 
-    *prefix_canary  = canary_val;
-    *postfix_canary = canary_val;
+    ReInitStackHash(stk);
+
+    CHECK_STACK(stk, CHECK_EXIT);
+
+    ON_STATS
+    (
+        stk->stats.pushes += count;
+        StatsAdd(STATS_PUSHES, count)
+    );
+
+    return (int) ERRORS::NONE;
 }
 
 //-----------------------------------------------------------------------------------------------------
 
-static bool VerifyCanary(const canary_t* prefix_canary, const canary_t* postfix_canary)
+int StackPopN(Stack_t* stk, elem_t* ret_values, size_t count)
 {
-    assert(prefix_canary);
-    assert(postfix_canary);
-    assert(prefix_canary != postfix_canary);
+    assert(stk);
+    assert(stk->data);
+    assert(ret_values);
 
-    if (*prefix_canary  != canary_val)
-        return false;
+    WriteSection section(stk);
+    CountInlineOps(stk);
 
-    if (*postfix_canary != canary_val)
-        return false;
+    if (stk->size < count)
+    {
+        ReportEmptyPop(stk, __func__, __FILE__, __LINE__);
+        return (int) ERRORS::INVALID_STACK;
+    }
 
-    return true;
-}
+    CHECK_STACK(stk, CHECK_ENTRY);
 
-//-----------------------------------------------------------------------------------------------------
+    if (count == 0)
+        return (int) ERRORS::NONE;
 
-static bool VerifyStackHash(const Stack_t* stk)
-{
-    assert(stk);
+    size_t first = stk->size - count;
+
+    memcpy(ret_values, stk->data + first, count * sizeof(elem_t));
 
     ON_HASH
     (
-        hash_t current_hash = stk->stack_hash;
+        HashSlots(stk, first, ret_values, count);
+        HashPoisonedSlots(stk, first, count)
+    );
 
-        if (current_hash != GetStackHash(stk))
-            return false;
+    PoisonData(stk->data + first, stk->data + stk->size);
+    MarkPoisonDirty(stk, first, stk->size);
 
-        return true
+    stk->size = first;
+    CountOperation(stk);
+
+    if (NeedShrink(stk))
+    {
+        ReInitStackHash(stk);
+        int realloc_error  = StackRealloc(stk, ShrinkCapacity(stk));
+        if (realloc_error != (int) ERRORS::NONE)
+            return realloc_error;
+    }
+
+    ReInitStackHash(stk);
+
+    CHECK_STACK(stk, CHECK_EXIT);
+
+    ON_STATS
+    (
+        stk->stats.pops += count;
+        StatsAdd(STATS_POPS, count)
     );
 
-    return false;
+    return (int) ERRORS::NONE;
 }
 
 //-----------------------------------------------------------------------------------------------------
 
-static bool VerifyDataHash(const Stack_t* stk)
+static void InitGrowthPolicy(GrowthPolicy* growth)
 {
-    assert(stk);
-
-    ON_HASH
-    (
-        hash_t current_hash = stk->data_hash;
+    assert(growth);
 
-        if (current_hash != GetDataHash(stk))
-            return false;
+    if (growth->grow_factor <= 1)
+        growth->grow_factor = DEFAULT_GROW_FACTOR;
 
-        return true
-    );
+    if (growth->shrink_threshold <= 0 || growth->shrink_threshold >= 1)
+        growth->shrink_threshold = DEFAULT_SHRINK_THRESHOLD;
 
-    return false;
+    // shrunk stack must not be full, otherwise next push grows it back (threshold gets half of the limit,
+    // as default threshold has)
+    if (growth->shrink_threshold >= 1 / growth->grow_factor)
+        growth->shrink_threshold = 0.5 / growth->grow_factor;
 }
 
 //-----------------------------------------------------------------------------------------------------
 
-static hash_t GetDataHash(const Stack_t* stk)
+static void UpdateFastLimits(Stack_t* stk)
 {
     assert(stk);
 
-    hash_t new_hash = 0;
-
-    ON_HASH
-    (
-        elem_t* data = stk->data;
-        size_t data_size = stk->capacity * sizeof(elem_t);
+    stk->fast_push_limit = 0;
+    stk->fast_pop_limit  = SIZE_MAX;
 
-        ON_CANARY
-        (
-            data      = (elem_t*)((char*) data - sizeof(canary_t));
-            data_size = data_size + 2 * sizeof(canary_t)
-        );
+#if STACK_FAST_PATH
+    // checks of other levels count operations, so operations can not skip them
+    if (stk->verify_level != VERIFY_OFF || stk->data == nullptr)
+        return;
 
-        new_hash = stk->hash_func(data, data_size);
-    );
+    stk->fast_push_limit = stk->capacity;
 
-    return new_hash;
+    // pop, after which size is greater than capacity * shrink_threshold, never shrinks stack
+    // (inline block is the smallest buffer, so stack in it never shrinks)
+    if (stk->growth.never_shrink || IsInline(stk->capacity))
+        stk->fast_pop_limit = 0;
+    else
+        stk->fast_pop_limit = (size_t) ((double) stk->capacity * stk->growth.shrink_threshold) + 1;
+#endif
 }
 
 //-----------------------------------------------------------------------------------------------------
 
-static hash_t GetStackHash(const Stack_t* stk)
+static size_t GrowCapacity(const Stack_t* stk, const size_t min_capacity)
 {
     assert(stk);
 
-    hash_t new_hash = 0;
-
-#pragma GCC diagnostic ignored "-Wcast-qual"
-    ON_HASH
-    (
-        hash_t stack_hash = stk->stack_hash;
-        int    status     = stk->status;
-        ((Stack_t*) stk)->status     = 0;
-        ((Stack_t*) stk)->stack_hash = 0;
+    size_t new_capacity = (size_t) ((double) stk->capacity * stk->growth.grow_factor);
 
-        new_hash = stk->hash_func(stk, sizeof(Stack_t));
+    if (new_capacity <= stk->capacity)
+        new_capacity = stk->capacity + 1;
 
-        ((Stack_t*) stk)->stack_hash = stack_hash;
-        ((Stack_t*) stk)->status     = status
-    );
-#pragma GCC diagnostic warning "-Wcast-qual"
+    if (new_capacity < min_capacity)
+        new_capacity = min_capacity;
 
-    return new_hash;;
+    return new_capacity;
 }
 
 //-----------------------------------------------------------------------------------------------------
 
-int StackDump(FILE* fp, const void* stack, const char* func, const char* file, const int line)
+static size_t ShrinkCapacity(const Stack_t* stk)
 {
-    assert(stack);
-    assert(func);
-    assert(file);
+    assert(stk);
 
-    const Stack_t* stk = (const Stack_t*) stack;
+    size_t new_capacity = stk->capacity;
 
-    LOG_START_MOD(func, file, line);
+    while ((double) stk->size <= (double) new_capacity * stk->growth.shrink_threshold)
+    {
+        size_t next_capacity = (size_t) ((double) new_capacity / stk->growth.grow_factor);
 
-    fprintf(fp, "Stack                > [%p]\n"
-                "size                 > %zu\n"
-                "capacity             > %zu\n"
-                "data place           > [%p]\n",
-                stk, stk->size, stk->capacity, stk->data);
+        if (next_capacity < stk->size)
+            next_capacity = stk->size;
 
-    ON_CANARY
-    (
-        fprintf(fp, "STACK PREFIX CANARY  > %llX\n"
-                    "STACK POSTFIX CANARY > %llX\n",
-                    stk->stack_prefix, stk->stack_postfix)
-    );
+        if (next_capacity < LEAST_CAPACITY)
+            next_capacity = LEAST_CAPACITY;
 
-    ON_HASH
-    (
-        fprintf(fp, "HASH FUNCTION        > [%p]\n"
-                    "::::::EXPECTED HASH::::::\n"
-                    "STACK HASH           > %u\n"
-                    "DATA HASH            > %u\n"
-                    "::::::CURRENT HASH::::::\n"
-                    "STACK CURRENT        > %u\n"
-                    "DATA CURRENT         > %u\n",
-                    stk->hash_func, stk->stack_hash, stk->data_hash,
-                    GetStackHash(stk), GetDataHash(stk))
-    );
+        if (next_capacity >= new_capacity)
+            break;
 
-    fprintf(fp, "ELEMENTS: \n\n");
+        new_capacity = next_capacity;
+    }
 
-    PrintStackData(fp, stk);
+    // capacity, that is not given by allocator (rounded up or taken by inline block), is not a reason to shrink
+    return FitCapacity(stk, new_capacity);
+}
 
-    ON_CANARY
-    (
-        canary_t* prefix_canary  = GetPrefixDataCanary(stk);
-        canary_t* postfix_canary = GetPostfixDataCanary(stk);
+//-----------------------------------------------------------------------------------------------------
 
-        fprintf(fp, "PREFIX DATA CANARY  > %llX\n"
-                    "POSTFIX DATA CANARY > %llX\n", *prefix_canary, *postfix_canary)
-    );
+static bool NeedShrink(const Stack_t* stk)
+{
+    assert(stk);
 
-    StackOk(stk);
-    if (stk->status != OK)
-        PrintStackCondition(stk);
+    if (stk->growth.never_shrink)
+        return false;
 
-    LOG_END();
+    if (stk->ops_since_realloc < stk->growth.min_dwell_ops)
+        return false;
 
-    return (int) ERRORS::NONE;
+    return ShrinkCapacity(stk) < stk->capacity;
 }
 
 //-----------------------------------------------------------------------------------------------------
 
-static inline void ReInitAllHashes(Stack_t* stk)
+// inline operations do not count themselves, so slow function counts them by size movement since previous
+// slow function (push and pop between two slow calls cancel each other, so it is a lower bound)
+static inline void CountInlineOps(Stack_t* stk)
 {
-    ON_HASH
-    (
-        stk->data_hash  = GetDataHash(stk);
-        stk->stack_hash = GetStackHash(stk)
-    );
+    assert(stk);
+
+#if STACK_FAST_PATH
+    stk->ops_since_realloc += (stk->size > stk->fast_size_mark) ? stk->size - stk->fast_size_mark :
+                                                                  stk->fast_size_mark - stk->size;
+    stk->fast_size_mark     = stk->size;
+#endif
 }
 
 //-----------------------------------------------------------------------------------------------------
 
-static size_t CountDataSize(const size_t capacity)
+static inline void CountOperation(Stack_t* stk)
 {
-    size_t size = capacity * sizeof(elem_t);
+    assert(stk);
 
-    ON_CANARY
-    (
-        size += 2 * sizeof(canary_t);
-        size += size % 8;
-    );
+    stk->ops_since_realloc++;
 
-    return size;
+#if STACK_FAST_PATH
+    stk->fast_size_mark = stk->size;
+#endif
 }
 
 //-----------------------------------------------------------------------------------------------------
 
-static inline bool EmptyStackCheck(Stack_t* stk)
+int StackOk(const Stack_t* stack)
 {
-    if (stk->size == 0)
-        return true;
+    assert(stack);
 
-    return false;
-}
+#pragma GCC diagnostic ignored "-Wcast-qual"
+    Stack_t* stk = (Stack_t*) stack;
+#pragma GCC diagnostic warning "-Wcast-qual"
 
-//-----------------------------------------------------------------------------------------------------
+    ON_STATS(uint64_t start = ReadTicks());
 
-static canary_t* GetPostfixDataCanary(const Stack_t* stk)
+    StackCheck(stk, DEPTH_FULL);
+
+    ON_STATS(stk->stats.check_ticks += CountTime(STATS_CHECKS, STATS_CHECK_NS, start));
+
+    return stk->status;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int StackRebase(Stack_t* stk, void* block, size_t block_size, const StackAllocator* allocator,
+                [[maybe_unused]] hash_f hash_func)
+{
+    assert(stk);
+    assert(allocator);
+
+    // registry slot belongs to previous owner of stack
+    stk->status        = OK;
+    stk->registry_slot = 0;
+
+    ON_CANARY
+    (
+        if (!VerifyCanary(&stk->stack_prefix, &stk->stack_postfix)) stk->status |= STACK_CANARY_TRIGGER
+    );
+
+    ON_HASH
+    (
+        if (hash_func == nullptr)
+            hash_func = MurmurHash;
+
+        // stack hash was counted with pointers of previous owner, so it is verified before they are replaced
+        if (CountStackHash(stk, hash_func) != stk->stack_hash)      stk->status |= INCORRECT_STACK_HASH
+    );
+
+    bool inline_data = IsInline(stk->capacity);
+
+    if (stk->size > stk->capacity)                                  stk->status |= INVALID_SIZE;
+    if (STACK_FIXED_CAPACITY && !inline_data)                       stk->status |= INVALID_CAPACITY;
+    if (!inline_data && (block == nullptr || CountDataSize(stk->capacity) != block_size))
+                                                                    stk->status |= INVALID_CAPACITY;
+
+    if (stk->status != OK)
+    {
+        // buffer does not belong to this stack, so stack keeps no data
+        stk->data = nullptr;
+        return stk->status;
+    }
+
+    AttachBlock(stk, (inline_data) ? GetInlineBlock(stk) : block);
+
+    stk->allocator = allocator;
+
+    UpdateFastLimits(stk);
+
+    // stack could be stopped in the middle of change by previous owner
+    stk->write_seq      = 0;
+    stk->fast_size_mark = stk->size;
+
+    ON_HASH
+    (
+        stk->hash_func = hash_func
+    );
+
+    ON_SAN_POISON(PoisonData(stk->data + stk->size, stk->data + stk->capacity));
+
+    ReInitStackHash(stk);
+
+    RegisterStack(stk);
+
+    // data canaries, poison and data hash are checked over whole buffer
+    return StackOk(stk);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int StackTakeSnapshot(const Stack_t* stk, StackSnapshot* snapshot)
+{
+    assert(stk);
+    assert(snapshot);
+
+    unsigned int seq = __atomic_load_n(&stk->write_seq, __ATOMIC_ACQUIRE);
+
+    if ((seq & 1) != 0)
+        return (int) ERRORS::WOULD_BLOCK;
+
+    Stack_t* copy = &snapshot->stk;
+
+    CopyStackHeader(copy, stk);
+
+    if (!SameWriteSeq(stk, seq))
+        return (int) ERRORS::WOULD_BLOCK;
+
+    // header is verified before its data pointer and capacity are trusted
+    copy->status = OK;
+
+    StackCheck(copy, DEPTH_HEADER);
+
+    if (copy->size > copy->capacity)                                copy->status |= INVALID_SIZE;
+    if (copy->data == nullptr)                                      copy->status |= INVALID_DATA;
+
+    if (copy->status != OK)
+        return (int) ERRORS::NONE;
+
+    size_t block_size = CountDataSize(copy->capacity);
+
+    if (snapshot->block_size < block_size)
+    {
+        void* block = realloc(snapshot->block, block_size);
+
+        if (block == nullptr)
+            return (int) ERRORS::ALLOCATE_MEMORY;
+
+        snapshot->block      = block;
+        snapshot->block_size = block_size;
+    }
+
+    const char* src = (const char*) copy->data;
+    char* dest      = (char*) snapshot->block;
+
+    ON_CANARY
+    (
+        src -= sizeof(canary_t)
+    );
+
+    OFF_SAN_POISON(memcpy(dest, src, block_size));
+
+    ON_SAN_POISON
+    (
+        // empty slots are poisoned, copy gets only elements and data canaries
+        size_t elems_end = (size_t)((const char*)(copy->data + copy->size) - src);
+        size_t tail      = (size_t)((const char*)(copy->data + copy->capacity) - src);
+
+        memcpy(dest, src, elems_end);
+        memcpy(dest + tail, src + tail, block_size - tail)
+    );
+
+    if (!SameWriteSeq(stk, seq))
+        return (int) ERRORS::WOULD_BLOCK;
+
+    AttachBlock(copy, snapshot->block);
+    ReInitStackHash(copy);
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void StackSnapshotDtor(StackSnapshot* snapshot)
+{
+    assert(snapshot);
+
+    free(snapshot->block);
+
+    snapshot->block      = nullptr;
+    snapshot->block_size = 0;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static int StackCheck(Stack_t* stk, const CheckDepth depth)
+{
+    assert(stk);
+
+    ON_CANARY
+    (
+        if (!VerifyCanary(&stk->stack_prefix, &stk->stack_postfix)) stk->status |= STACK_CANARY_TRIGGER
+    );
+
+    if (depth == DEPTH_HEADER)
+    {
+        ON_HASH
+        (
+            if (!stk->hash_func)                                    stk->status |= INVALID_HASH_FUNC;
+            else if (!VerifyStackHash(stk))                         stk->status |= INCORRECT_STACK_HASH
+        );
+
+        return stk->status;
+    }
+
+    ON_CANARY
+    (
+        canary_t* prefix_canary  = GetPrefixDataCanary(stk);
+        canary_t* postfix_canary = GetPostfixDataCanary(stk);
+
+        if (!VerifyCanary(prefix_canary, postfix_canary))           stk->status |= DATA_CANARY_TRIGGER
+    );
+
+    if (stk->capacity <= 0)                                         stk->status |= INVALID_CAPACITY;
+    if (stk->size > stk->capacity)                                  stk->status |= INVALID_SIZE;
+    if (stk->data == nullptr && stk->capacity != 0)                 stk->status |= INVALID_DATA;
+    bool poison_ok = (depth == DEPTH_FULL) ? PoisonVerify(stk) : PoisonVerifyStep(stk);
+
+    if (!poison_ok)                                                 stk->status |= POISON_ACCESS;
+
+    ON_HASH
+    (
+        if (!stk->hash_func)
+        {
+            stk->status |= INVALID_HASH_FUNC;
+            return stk->status;
+        }
+
+        bool data_hash_ok = (depth == DEPTH_FULL) ? VerifyDataHash(stk) : ScrubDataHash(stk);
+
+        if (!data_hash_ok)                                          stk->status |= INCORRECT_DATA_HASH;
+        if (!VerifyStackHash(stk))                                  stk->status |= INCORRECT_STACK_HASH
+    );
+
+    return stk->status;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void InitCanary(canary_t* prefix_canary, canary_t* postfix_canary)
+{
+    assert(prefix_canary);
+    assert(postfix_canary);
+    assert(prefix_canary != postfix_canary);
+
+    *prefix_canary  = canary_val;
+    *postfix_canary = canary_val;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static bool VerifyCanary(const canary_t* prefix_canary, const canary_t* postfix_canary)
+{
+    assert(prefix_canary);
+    assert(postfix_canary);
+    assert(prefix_canary != postfix_canary);
+
+    if (*prefix_canary  != canary_val)
+        return false;
+
+    if (*postfix_canary != canary_val)
+        return false;
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static bool VerifyStackHash(const Stack_t* stk)
+{
+    assert(stk);
+
+    ON_HASH
+    (
+        hash_t current_hash = stk->stack_hash;
+
+        if (current_hash != GetStackHash(stk))
+            return false;
+
+        return true
+    );
+
+    return false;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static bool VerifyDataHash(const Stack_t* stk)
+{
+    assert(stk);
+
+    ON_HASH
+    (
+        hash_t current_hash = stk->data_hash;
+
+        if (current_hash != GetDataHash(stk))
+            return false;
+
+        return true
+    );
+
+    return false;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static hash_t GetDataHash(const Stack_t* stk)
+{
+    assert(stk);
+
+    hash_t new_hash = 0;
+
+    ON_HASH
+    (
+        for (size_t i = 0; i < stk->capacity; i++)
+            new_hash ^= SlotHash(stk, i, ReadSlot(stk, i))
+    );
+
+    return new_hash;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static hash_t GetStackHash(const Stack_t* stk)
+{
+    assert(stk);
+
+    hash_t new_hash = 0;
+
+    ON_HASH
+    (
+        new_hash = CountStackHash(stk, stk->hash_func)
+    );
+
+    return new_hash;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+#if HASH_PROTECT
+static hash_t CountStackHash(const Stack_t* stk, hash_f hash_func)
+{
+    assert(stk);
+    assert(hash_func);
+
+    // fields, that change without stack being changed, are not hashed
+    Stack_t snapshot = {};
+    CopyStackHeader(&snapshot, stk);
+
+    snapshot.status         = 0;
+    snapshot.write_seq      = 0;
+    snapshot.registry_slot  = 0;
+    snapshot.stack_hash     = 0;
+    snapshot.hash_scrub_pos = 0;
+    snapshot.hash_scrub_acc = 0;
+    snapshot.stats          = {};
+
+    snapshot.poison_dirty_left  = 0;
+    snapshot.poison_dirty_right = 0;
+    snapshot.poison_scrub_pos   = 0;
+
+    return hash_func(&snapshot, sizeof(Stack_t));
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static bool ScrubDataHash(Stack_t* stk)
+{
+    assert(stk);
+
+    size_t end = stk->hash_scrub_pos + HASH_SCRUB_STEP;
+    if (end > stk->capacity)
+        end = stk->capacity;
+
+    for (size_t i = stk->hash_scrub_pos; i < end; i++)
+        stk->hash_scrub_acc ^= SlotHash(stk, i, ReadSlot(stk, i));
+
+    stk->hash_scrub_pos = end;
+
+    if (end < stk->capacity)
+        return true;
+
+    hash_t scrubbed_hash = stk->hash_scrub_acc;
+
+    stk->hash_scrub_pos = 0;
+    stk->hash_scrub_acc = 0;
+
+    return scrubbed_hash == stk->data_hash;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline hash_t SlotHash(const Stack_t* stk, const size_t index, const elem_t value)
+{
+    assert(stk);
+
+    struct
+    {
+        size_t index;
+        elem_t value;
+    } slot = {index, value};
+
+    return stk->hash_func(&slot, sizeof(slot));
+}
+#endif
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline void WriteSlot(Stack_t* stk, const size_t index, [[maybe_unused]] const elem_t old_value,
+                             const elem_t new_value)
+{
+    assert(stk);
+    assert(index < stk->capacity);
+
+    ON_HASH
+    (
+        hash_t delta = SlotHash(stk, index, old_value) ^ SlotHash(stk, index, new_value);
+
+        stk->data_hash ^= delta;
+
+        if (index < stk->hash_scrub_pos)
+            stk->hash_scrub_acc ^= delta
+    );
+
+    (stk->data)[index] = new_value;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+#if HASH_PROTECT
+static void HashSlots(Stack_t* stk, const size_t first, const elem_t* values, const size_t count)
+{
+    assert(stk);
+    assert(values);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        hash_t delta = SlotHash(stk, first + i, values[i]);
+
+        stk->data_hash ^= delta;
+
+        if (first + i < stk->hash_scrub_pos)
+            stk->hash_scrub_acc ^= delta;
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void HashPoisonedSlots(Stack_t* stk, const size_t first, const size_t count)
+{
+    assert(stk);
+
+    for (size_t i = first; i < first + count; i++)
+    {
+        hash_t delta = SlotHash(stk, i, POISON);
+
+        stk->data_hash ^= delta;
+
+        if (i < stk->hash_scrub_pos)
+            stk->hash_scrub_acc ^= delta;
+    }
+}
+#endif
+
+//-----------------------------------------------------------------------------------------------------
+
+static void InitDataHash(Stack_t* stk)
+{
+    assert(stk);
+
+    ON_HASH
+    (
+        stk->data_hash      = GetDataHash(stk);
+        stk->hash_scrub_pos = 0;
+        stk->hash_scrub_acc = 0
+    );
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+#if HASH_PROTECT
+static void ResizeDataHash(Stack_t* stk, const size_t old_capacity, const size_t new_capacity)
+{
+    assert(stk);
+
+    size_t left  = (old_capacity < new_capacity) ? old_capacity : new_capacity;
+    size_t right = (old_capacity < new_capacity) ? new_capacity : old_capacity;
+
+    // added and removed slots are always poisoned
+    for (size_t i = left; i < right; i++)
+        stk->data_hash ^= SlotHash(stk, i, POISON);
+
+    stk->hash_scrub_pos = 0;
+    stk->hash_scrub_acc = 0;
+}
+#endif
+
+//-----------------------------------------------------------------------------------------------------
+
+__attribute__((cold, noinline))
+int StackDump(FILE* fp, const void* stack, const char* func, const char* file, const int line)
+{
+    assert(stack);
+    assert(func);
+    assert(file);
+
+    const Stack_t* stk = (const Stack_t*) stack;
+
+    ON_STATS(uint64_t start = ReadTicks());
+
+    FILE* dump_fp = GetDumpFile();
+
+    if (dump_fp != nullptr)
+    {
+        // elements are formatted offline by stackdump-decode, log gets only reference to record
+        long offset = 0;
+        int error   = WriteDumpRecord(dump_fp, stk, func, file, line, &offset);
+
+        LOG_START_MOD(func, file, line);
+
+        fprintf(fp, "Stack                > [%p]\n"
+                    "size                 > %zu\n"
+                    "capacity             > %zu\n"
+                    "BINARY DUMP OFFSET   > %ld\n",
+                    stk, stk->size, stk->capacity, offset);
+
+        if (stk->status != OK)
+            PrintStackCondition(stk);
+
+        LOG_END();
+
+        ON_STATS(CountDump(stk, start));
+
+        return error;
+    }
+
+    LOG_START_MOD(func, file, line);
+
+    fprintf(fp, "Stack                > [%p]\n"
+                "size                 > %zu\n"
+                "capacity             > %zu\n"
+                "data place           > [%p]\n"
+                "verify level         > %d\n"
+                "checks run/skipped   > %zu/%zu\n"
+                "reallocs             > %zu (%zu bytes copied)\n",
+                stk, stk->size, stk->capacity, stk->data,
+                stk->verify_level, stk->stats.checks_run, stk->stats.checks_skipped,
+                stk->stats.reallocs, stk->stats.bytes_copied);
+
+    ON_STATS
+    (
+        fprintf(fp, "pushes/pops          > %zu/%zu\n"
+                    "dumps                > %zu\n"
+                    "check/realloc ns     > %" PRIu64 "/%" PRIu64 "\n",
+                    stk->stats.pushes, stk->stats.pops, stk->stats.dumps,
+                    TicksToNs(stk->stats.check_ticks), TicksToNs(stk->stats.realloc_ticks))
+    );
+
+    ON_CANARY
+    (
+        fprintf(fp, "STACK PREFIX CANARY  > %llX\n"
+                    "STACK POSTFIX CANARY > %llX\n",
+                    stk->stack_prefix, stk->stack_postfix)
+    );
+
+    ON_HASH
+    (
+        fprintf(fp, "HASH FUNCTION        > [%p]\n"
+                    "::::::EXPECTED HASH::::::\n"
+                    "STACK HASH           > %u\n"
+                    "DATA HASH            > %u\n"
+                    "::::::CURRENT HASH::::::\n"
+                    "STACK CURRENT        > %u\n"
+                    "DATA CURRENT         > %u\n",
+                    stk->hash_func, stk->stack_hash, stk->data_hash,
+                    GetStackHash(stk), GetDataHash(stk))
+    );
+
+    fprintf(fp, "ELEMENTS: \n\n");
+
+    PrintStackData(fp, stk);
+
+    ON_CANARY
+    (
+        canary_t* prefix_canary  = GetPrefixDataCanary(stk);
+        canary_t* postfix_canary = GetPostfixDataCanary(stk);
+
+        fprintf(fp, "PREFIX DATA CANARY  > %llX\n"
+                    "POSTFIX DATA CANARY > %llX\n", *prefix_canary, *postfix_canary)
+    );
+
+    StackOk(stk);
+    if (stk->status != OK)
+        PrintStackCondition(stk);
+
+    LOG_END();
+
+    ON_STATS(CountDump(stk, start));
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int StackDumpBinary(FILE* fp, const void* stack, const char* func, const char* file, const int line)
+{
+    assert(stack);
+
+    long offset = 0;
+
+    return WriteDumpRecord(fp, (const Stack_t*) stack, func, file, line, &offset);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static int WriteDumpRecord(FILE* fp, const Stack_t* stk, const char* func, const char* file, const int line,
+                           long* offset)
+{
+    assert(fp);
+    assert(stk);
+    assert(func);
+    assert(file);
+    assert(offset);
+
+    StackOk(stk);
+
+    StackDumpHeader header = {};
+
+    memcpy(header.magic, STACK_DUMP_MAGIC, sizeof(header.magic));
+
+    header.version        = STACK_DUMP_VERSION;
+    header.elem_size      = sizeof(elem_t);
+    header.status         = stk->status;
+    header.verify_level   = stk->verify_level;
+    header.line           = line;
+    header.time           = time(nullptr);
+    header.stack_addr     = (uintptr_t) stk;
+    header.data_addr      = (uintptr_t) stk->data;
+    header.size           = stk->size;
+    header.capacity       = stk->capacity;
+    header.checks_run     = stk->stats.checks_run;
+    header.checks_skipped = stk->stats.checks_skipped;
+    header.reallocs       = stk->stats.reallocs;
+    header.bytes_copied   = stk->stats.bytes_copied;
+    header.func_len       = (uint32_t) strlen(func);
+    header.file_len       = (uint32_t) strlen(file);
+    header.data_count     = (stk->data != nullptr) ? stk->capacity : 0;
+
+    // poisoned slots can not be read, so only elements are written
+    ON_SAN_POISON(header.data_count = (stk->data != nullptr) ? stk->size : 0);
+
+    ON_CANARY
+    (
+        header.flags        |= DUMP_CANARY;
+        header.stack_prefix  = stk->stack_prefix;
+        header.stack_postfix = stk->stack_postfix;
+
+        if (stk->data != nullptr)
+        {
+            header.data_prefix  = *GetPrefixDataCanary(stk);
+            header.data_postfix = *GetPostfixDataCanary(stk);
+        }
+    );
+
+    ON_HASH
+    (
+        header.flags          |= DUMP_HASH;
+        header.hash_func_addr  = (uintptr_t) stk->hash_func;
+        header.stack_hash      = stk->stack_hash;
+        header.data_hash       = stk->data_hash;
+
+        if (stk->hash_func != nullptr)
+        {
+            header.stack_current = GetStackHash(stk);
+            header.data_current  = GetDataHash(stk);
+        }
+    );
+
+    // record of one stack is never mixed with records of other threads
+    flockfile(fp);
+
+    *offset = ftell(fp);
+
+    bool written = fwrite(&header, sizeof(header), 1, fp) == 1                                          &&
+                   fwrite(func, 1, header.func_len, fp) == header.func_len                              &&
+                   fwrite(file, 1, header.file_len, fp) == header.file_len                              &&
+                   fwrite(stk->data, sizeof(elem_t), header.data_count, fp) == header.data_count;
+
+    fflush(fp);
+
+    funlockfile(fp);
+
+    return written ? (int) ERRORS::NONE : (int) ERRORS::PRINT_DATA;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline void ReInitStackHash(Stack_t* stk)
+{
+    ON_HASH
+    (
+        stk->stack_hash = GetStackHash(stk)
+    );
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static size_t CountDataSize(const size_t capacity)
+{
+    size_t size = capacity * sizeof(elem_t);
+
+    ON_CANARY
+    (
+        size += 2 * sizeof(canary_t);
+        size += size % 8;
+    );
+
+    return size;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static size_t FitCapacity(const Stack_t* stk, size_t capacity)
+{
+    assert(stk);
+
+    ON_INLINE
+    (
+        if (capacity <= STACK_INLINE_CAPACITY)
+            return STACK_INLINE_CAPACITY;
+
+        // buffer of allocator is not smaller than usual one
+        if (capacity < MIN_CAPACITY)
+            capacity = MIN_CAPACITY
+    );
+
+    if (stk->allocator != &GUARD_ALLOCATOR)
+        return capacity;
+
+    // buffer fills its pages, so both its ends touch guard pages
+    return (GuardPagesRound(CountDataSize(capacity)) - CountDataSize(0)) / sizeof(elem_t);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline bool IsInline(const size_t capacity)
+{
+    return STACK_INLINE_CAPACITY != 0 && capacity != 0 && capacity <= STACK_INLINE_CAPACITY;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static elem_t* GetInlineBlock(Stack_t* stk)
+{
+    assert(stk);
+
+    ON_INLINE
+    (
+        return (elem_t*) stk->inline_block
+    );
+
+    return nullptr;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void* ResizeBlock(Stack_t* stk, void* block, const size_t old_capacity, const size_t new_capacity)
+{
+    assert(stk);
+    assert(block);
+
+    const StackAllocator* allocator = stk->allocator;
+
+    size_t old_size = CountDataSize(old_capacity);
+    size_t new_size = CountDataSize(new_capacity);
+
+    if (!IsInline(old_capacity) && !IsInline(new_capacity))
+        return allocator->realloc(allocator->ctx, block, old_size, new_size);
+
+    // data is moved out of inline block or back to it (capacities differ, so only one of blocks is inline)
+    void* new_block = (IsInline(new_capacity)) ? GetInlineBlock(stk) : allocator->alloc(allocator->ctx, new_size);
+
+    if (new_block == nullptr)
+        return nullptr;
+
+    memcpy(new_block, block, (old_size < new_size) ? old_size : new_size);
+
+    if (!IsInline(old_capacity))
+    {
+        if (allocator == &GUARD_ALLOCATOR)
+            GuardPagesUnwatch(stk);
+
+        allocator->free(allocator->ctx, block, old_size);
+    }
+
+    return new_block;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void CopyStackHeader(Stack_t* dest, const Stack_t* src)
+{
+    assert(dest);
+    assert(src);
+
+    OFF_INLINE(memcpy(dest, src, sizeof(Stack_t)));
+
+    ON_INLINE
+    (
+        // inline block is data, it is copied (or hashed) with the rest of data, and its empty slots can be
+        // poisoned for sanitizer
+        size_t block_begin = offsetof(Stack_t, inline_block);
+        size_t block_end   = block_begin + sizeof(src->inline_block);
+
+        memcpy(dest, src, block_begin);
+        memcpy((char*) dest + block_end, (const char*) src + block_end, sizeof(Stack_t) - block_end)
+    );
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void WatchData(const Stack_t* stk, const void* block, const size_t size)
+{
+    assert(stk);
+    assert(block);
+
+    if (stk->allocator == &GUARD_ALLOCATOR && GuardPagesWatch(stk, block, size) != (int) ERRORS::NONE)
+        PrintLog("GUARD PAGES OF STACK [%p] ARE NOT WATCHED\n", stk);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void AttachBlock(Stack_t* stk, void* block)
+{
+    assert(stk);
+    assert(block);
+
+    elem_t* first_elem = (elem_t*) block;
+
+    ON_CANARY
+    (
+        first_elem = (elem_t*)((char*) block + sizeof(canary_t))
+    );
+
+    stk->data = first_elem;
+
+    stk->poison_dirty_left  = 0;
+    stk->poison_dirty_right = 0;
+    stk->poison_scrub_pos   = 0;
+
+    ON_HASH
+    (
+        stk->hash_scrub_pos = 0;
+        stk->hash_scrub_acc = 0
+    );
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void RegisterStack(Stack_t* stk)
+{
+    assert(stk);
+
+    // without verifier registry is not needed, so stacks do not take its lock
+    if (!stk->verify_background && !VerifierRunning())
+        return;
+
+    if (StackRegistryAdd(stk) != (int) ERRORS::NONE)
+        PrintLog("STACK [%p] IS NOT REGISTERED FOR BACKGROUND VERIFICATION\n", stk);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline bool SameWriteSeq(const Stack_t* stk, const unsigned int seq)
+{
+    // copy is read before write sequence is read again
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    return __atomic_load_n(&stk->write_seq, __ATOMIC_RELAXED) == seq;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+#if STACK_STATS
+static inline uint64_t CountTime(const StatsCounter counter, const StatsCounter time_counter, const uint64_t start)
+{
+    uint64_t ticks = ReadTicks() - start;
+
+    StatsAdd(counter, 1);
+    StatsAdd(time_counter, ticks);
+
+    return ticks;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void CountDump(const Stack_t* stk, const uint64_t start)
+{
+    assert(stk);
+
+#pragma GCC diagnostic ignored "-Wcast-qual"
+    ((Stack_t*) stk)->stats.dumps++;
+#pragma GCC diagnostic warning "-Wcast-qual"
+
+    CountTime(STATS_DUMPS, STATS_DUMP_NS, start);
+}
+#endif
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline bool EmptyStackCheck(Stack_t* stk)
+{
+    if (stk->size == 0)
+        return true;
+
+    return false;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static canary_t* GetPostfixDataCanary(const Stack_t* stk)
 {
     canary_t* postfix_canary = (canary_t*)((char*) stk->data +
                                             CountDataSize(stk->capacity) - 2 * sizeof(canary_t));
@@ -509,6 +1640,7 @@ static canary_t* GetPrefixDataCanary(const Stack_t* stk)
 
 //-----------------------------------------------------------------------------------------------------
 
+__attribute__((cold, noinline))
 static void PrintStackCondition(const Stack_t* stk)
 {
     PrintLog("\n>>>>>>>>>>STACK CONDITIONS<<<<<<<<<\n");
@@ -550,6 +1682,10 @@ static void PrintStackCondition(const Stack_t* stk)
                     "LEFT CANARY:     %llu\n"
                     "RIGHT CANARY:    %llu\n",
                     stk->stack_prefix, stk->stack_postfix);
+    #else
+    // without canaries data canary trigger is set only by guard page fault
+    if ((stk->status & DATA_CANARY_TRIGGER) != 0)
+        PrintLog("DATA GUARD PAGE TRIGGERED\n");
     #endif
 
     #if HASH_PROTECT
@@ -579,13 +1715,63 @@ static void PrintStackCondition(const Stack_t* stk)
 
 //-----------------------------------------------------------------------------------------------------
 
-static inline bool IsStackValid(Stack* stack, const char* func, const char* file, const int line)
+static bool NeedCheck(Stack_t* stk, const CheckPoint point)
+{
+    assert(stk);
+
+    if (point == CHECK_ENTRY)
+        stk->stats.operations++;
+
+    switch (stk->verify_level)
+    {
+        case (VERIFY_FULL):
+        case (VERIFY_HEADER):
+            return true;
+
+        case (VERIFY_ENTRY):
+            return point == CHECK_ENTRY;
+
+        case (VERIFY_SAMPLED):
+            return stk->stats.operations % stk->verify_period == 0;
+
+        case (VERIFY_OFF):
+            return false;
+
+        default:
+            return true;
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline bool IsStackValid(Stack* stack, const CheckPoint point,
+                                const char* func, const char* file, const int line)
 {
-    StackOk(stack);
+    if (!NeedCheck(stack, point))
+    {
+        stack->stats.checks_skipped++;
+        return true;
+    }
+
+    stack->stats.checks_run++;
+
+    ON_STATS(uint64_t start = ReadTicks());
+
+    // full level recounts data hash and verifies poison over whole buffer, cheaper levels do it by steps
+    CheckDepth depth = DEPTH_STEP;
+
+    if (stack->verify_level == VERIFY_FULL)
+        depth = DEPTH_FULL;
+    else if (stack->verify_level == VERIFY_HEADER)
+        depth = DEPTH_HEADER;
+
+    StackCheck(stack, depth);
+
+    ON_STATS(stack->stats.check_ticks += CountTime(STATS_CHECKS, STATS_CHECK_NS, start));
+
     if (stack->status != OK)
     {
-        const void* stk = (const void*) stack;
-        LogDump(StackDump, stk, func, file, line);
+        ReportInvalidStack(stack, func, file, line);
         return false;
     }
 
@@ -594,6 +1780,23 @@ static inline bool IsStackValid(Stack* stack, const char* func, const char* file
 
 //-----------------------------------------------------------------------------------------------------
 
+__attribute__((cold, noinline))
+static void ReportInvalidStack(const Stack_t* stk, const char* func, const char* file, const int line)
+{
+    LogDump(StackDump, stk, func, file, line);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+__attribute__((cold, noinline))
+static void ReportEmptyPop(Stack_t* stk, const char* func, const char* file, const int line)
+{
+    stk->status |= EMPTY_STACK;
+    LogDump(StackDump, stk, func, file, line);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
 static int PrintStackData(FILE* fp, const Stack_t* stk)
 {
     for (size_t i = 0; i < stk->size; i++)
@@ -605,8 +1808,10 @@ static int PrintStackData(FILE* fp, const Stack_t* stk)
 
     for (size_t i = stk->size; i < stk->capacity; i++)
     {
-        fprintf(fp, "*[%zu] > " PRINT_ELEM_T, i, stk->data[i]);
-        if (Equal((stk->data[i]), POISON))
+        elem_t value = ReadSlot(stk, i);
+
+        fprintf(fp, "*[%zu] > " PRINT_ELEM_T, i, value);
+        if (Equal(value, POISON))
             fprintf(fp, " (POISONED)");
         fprintf(fp, "\n");
     }
@@ -620,40 +1825,118 @@ static void PoisonData(elem_t* left_border, elem_t* right_border)
 {
     assert(left_border);
     assert(right_border);
+    assert(left_border <= right_border);
 
-    for (elem_t* iterator = left_border; iterator < right_border; iterator++)
-    {
-        *iterator = POISON;
-    }
+    ON_SAN_POISON(POISON_REGION(left_border, (size_t)((char*) right_border - (char*) left_border)));
+
+    OFF_SAN_POISON(PoisonFill(left_border, (size_t)(right_border - left_border), POISON));
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+#if SANITIZER_POISON
+static void UnpoisonData(elem_t* left_border, elem_t* right_border)
+{
+    assert(left_border);
+    assert(right_border);
+    assert(left_border <= right_border);
+
+    UNPOISON_REGION(left_border, (size_t)((char*) right_border - (char*) left_border));
+}
+#endif
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline elem_t ReadSlot(const Stack_t* stk, const size_t index)
+{
+    assert(stk);
+
+    // empty slot is poisoned by sanitizer, and its logical value is POISON
+    ON_SAN_POISON(if (index >= stk->size) return POISON);
+
+    return stk->data[index];
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static bool PoisonVerify(const Stack_t* stk)
+{
+    assert(stk);
+
+    return PoisonVerifyRange(stk, stk->size, stk->capacity);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static bool PoisonVerifyRange(const Stack_t* stk, size_t left, size_t right)
+{
+    assert(stk);
+
+    if (left < stk->size)
+        left = stk->size;
+    if (right > stk->capacity)
+        right = stk->capacity;
+
+    if (left >= right)
+        return true;
+
+    // sanitizer catches access to empty slots itself
+    ON_SAN_POISON(return true);
+
+    return PoisonCheck(stk->data + left, right - left, POISON);
 }
 
 //-----------------------------------------------------------------------------------------------------
 
-static bool PoisonVerify(Stack_t* stk)
+static bool PoisonVerifyStep(Stack_t* stk)
 {
-    elem_t* left_border  = (elem_t*)((char*)stk->data + stk->size * sizeof(elem_t));
-    elem_t* right_border = (elem_t*)((char*)stk->data + stk->capacity * sizeof(elem_t));
+    assert(stk);
 
-    for (elem_t* iterator = left_border; iterator < right_border - 1; iterator++)
+    bool is_poisoned = PoisonVerifyRange(stk, stk->size, stk->size + POISON_GUARD);
+
+    if (stk->poison_dirty_left < stk->poison_dirty_right)
     {
-        if (!Equal(POISON, *iterator))
-        {
-            return false;
-        }
+        is_poisoned = PoisonVerifyRange(stk, stk->poison_dirty_left, stk->poison_dirty_right) && is_poisoned;
+
+        stk->poison_dirty_left  = 0;
+        stk->poison_dirty_right = 0;
     }
 
-    return true;
+    if (stk->poison_scrub_pos < stk->size || stk->poison_scrub_pos >= stk->capacity)
+        stk->poison_scrub_pos = stk->size;
+
+    size_t scrub_end = stk->poison_scrub_pos + POISON_SCRUB_STEP;
+
+    is_poisoned = PoisonVerifyRange(stk, stk->poison_scrub_pos, scrub_end) && is_poisoned;
+
+    stk->poison_scrub_pos = scrub_end;
+
+    return is_poisoned;
 }
 
 //-----------------------------------------------------------------------------------------------------
 
-bool Equal(const elem_t a, const elem_t b)
+static inline void MarkPoisonDirty(Stack_t* stk, const size_t left, const size_t right)
 {
+    assert(stk);
+    assert(left < right);
 
-    if (isnan(a) && isnan(b))
-        return true;
+    if (stk->poison_dirty_left >= stk->poison_dirty_right)
+    {
+        stk->poison_dirty_left  = left;
+        stk->poison_dirty_right = right;
+        return;
+    }
 
-    // const elem_t EPSILON = 1e-5;
+    if (left < stk->poison_dirty_left)
+        stk->poison_dirty_left = left;
+    if (right > stk->poison_dirty_right)
+        stk->poison_dirty_right = right;
+}
+
+//-----------------------------------------------------------------------------------------------------
 
+static bool Equal(const elem_t a, const elem_t b)
+{
     return a == b;
 }
@@ -2,10 +2,12 @@
 #define __STACK_H_
 
 #include <stdio.h>
+#include <stdint.h>
 
 #include "errors.h"
 #include "log_funcs.h"
 #include "types.h"
+#include "allocator.h"
 
 /*! \file
 * \brief Contains hash functions
@@ -33,6 +35,78 @@
 
 #endif
 
+#ifndef GUARD_PAGE_PROTECT
+/************************************************************//**
+ * @brief Guard page protection (stack buffers are surrounded by inaccessible pages by default,
+ * access out of buffer faults at once and gets dumped as DATA_CANARY_TRIGGER)
+ *
+ * 1 for ON
+ * 0 for OFF
+ ************************************************************/
+#define GUARD_PAGE_PROTECT 0
+
+#endif
+
+#ifndef SANITIZER_POISON
+/************************************************************//**
+ * @brief Sanitizer poisoning (empty slots are marked for AddressSanitizer or Valgrind instead of being
+ * filled with POISON, so access to them is caught by the faulting instruction, poison checks are off)
+ *
+ * 1 for ON
+ * 0 for OFF
+ ************************************************************/
+#define SANITIZER_POISON 0
+
+#endif
+
+#ifndef STACK_STATS
+/************************************************************//**
+ * @brief Stack statistics (operation counters of every stack, global counters and
+ * push and pop latency histograms of stack_stats.h)
+ *
+ * 1 for ON
+ * 0 for OFF
+ ************************************************************/
+#define STACK_STATS 0
+
+#endif
+
+#ifndef STACK_INLINE_CAPACITY
+/************************************************************//**
+ * @brief Small buffer of stack (first STACK_INLINE_CAPACITY elements with data canaries live inside Stack,
+ * stack moves them to allocator, when it outgrows them, and back, when it shrinks)
+ *
+ * amount of inline elements
+ * 0 for OFF
+ ************************************************************/
+#define STACK_INLINE_CAPACITY 0
+
+#endif
+
+#ifndef STACK_FIXED_CAPACITY
+/************************************************************//**
+ * @brief Fixed capacity (stack keeps only STACK_INLINE_CAPACITY inline elements and never allocates,
+ * push to full stack returns ERRORS::FULL_STACK)
+ *
+ * 1 for ON
+ * 0 for OFF
+ ************************************************************/
+#define STACK_FIXED_CAPACITY 0
+
+#endif
+
+#if STACK_FIXED_CAPACITY && !STACK_INLINE_CAPACITY
+#error "STACK_FIXED_CAPACITY needs STACK_INLINE_CAPACITY"
+#endif
+
+/// inline fast path of StackPush and StackPop (it is compiled, only if nothing has to be done per operation)
+#if !CANARY_PROTECT && !HASH_PROTECT && !SANITIZER_POISON && !STACK_STATS
+#define STACK_FAST_PATH 1
+
+#else
+#define STACK_FAST_PATH 0
+#endif
+
 #if CANARY_PROTECT
 #define ON_CANARY(...) __VA_ARGS__
 #define OFF_CANARY(...) ;
@@ -42,6 +116,31 @@
 #define OFF_CANARY(...) __VA_ARGS__
 #endif
 
+#if SANITIZER_POISON
+#define ON_SAN_POISON(...) __VA_ARGS__
+#define OFF_SAN_POISON(...) ;
+
+#else
+#define ON_SAN_POISON(...) ;
+#define OFF_SAN_POISON(...) __VA_ARGS__
+#endif
+
+#if STACK_STATS
+#define ON_STATS(...) __VA_ARGS__
+
+#else
+#define ON_STATS(...) ;
+#endif
+
+#if STACK_INLINE_CAPACITY
+#define ON_INLINE(...) __VA_ARGS__
+#define OFF_INLINE(...) ;
+
+#else
+#define ON_INLINE(...) ;
+#define OFF_INLINE(...) __VA_ARGS__
+#endif
+
 #if HASH_PROTECT
 #define ON_HASH(...) __VA_ARGS__
 
@@ -57,6 +156,98 @@
 
 static const size_t MIN_CAPACITY = 16;
 
+/// default capacity of new stack (stack with inline elements starts in them)
+static const size_t DEFAULT_CAPACITY = (STACK_INLINE_CAPACITY != 0) ? STACK_INLINE_CAPACITY : MIN_CAPACITY;
+
+/// size of inline block of stack (inline elements and data canaries)
+static const size_t STACK_INLINE_BLOCK_SIZE = STACK_INLINE_CAPACITY * sizeof(elem_t) +
+                                              ((CANARY_PROTECT) ? 2 * sizeof(canary_t) : 0);
+
+/// value of empty slots
+static const elem_t STACK_POISON = -123456789;
+
+/// value of canaries (of every stack kind)
+static const canary_t STACK_CANARY = 0xD07ADEAD;
+
+/// size of cache line (atomics, that are contended by threads, are kept in separate lines)
+static const size_t CACHE_LINE_SIZE = 64;
+
+/// amount of slots, that every stack check below VERIFY_FULL level folds into data hash verification
+static const size_t HASH_SCRUB_STEP = 64;
+
+/// amount of empty slots above stack top, that every stack check verifies to be poisoned
+static const size_t POISON_GUARD = 4;
+
+/// amount of empty slots, that every stack check below VERIFY_FULL level additionally verifies to be poisoned
+static const size_t POISON_SCRUB_STEP = 64;
+
+/// default amount of operations between checks in VERIFY_SAMPLED level
+static const size_t DEFAULT_VERIFY_PERIOD = 64;
+
+/// @brief stack verification levels (which checks stack operations run)
+enum StackVerifyLevel
+{
+    /// check at entry and exit of every operation (data hash and poison are verified over whole buffer)
+    VERIFY_FULL    = 0,
+    /// check at entry of every operation
+    VERIFY_ENTRY   = 1,
+    /// check at entry and exit of every verify_period-th operation
+    VERIFY_SAMPLED = 2,
+    /// check only stack canaries and stack hash at entry and exit of every operation
+    VERIFY_HEADER  = 3,
+    /// no checks (StackOk still checks everything)
+    VERIFY_OFF     = 4
+};
+
+/// default capacity multiplier of growing stack
+static const double DEFAULT_GROW_FACTOR      = 2;
+/// default part of capacity, that stack should fill to avoid shrinking
+static const double DEFAULT_SHRINK_THRESHOLD = 0.25;
+
+/// @brief stack capacity growth policy (zero fields mean default values)
+struct GrowthPolicy
+{
+    /// capacity multiplier when stack is full (must be > 1), shrinking divides capacity by it
+    double grow_factor;
+    /// stack shrinks when size <= capacity * shrink_threshold (it is clamped to 0.5 / grow_factor, if it is not
+    /// less than 1 / grow_factor, to avoid thrashing)
+    double shrink_threshold;
+    /// amount of operations after last realloc, before stack is allowed to shrink
+    /// (inline operations of fast path are counted by size movement)
+    size_t min_dwell_ops;
+    /// stack never shrinks
+    bool   never_shrink;
+};
+
+/// @brief stack counters (they are not covered by stack hash)
+struct StackStats
+{
+    /// stack operations
+    size_t operations;
+    /// checks, that were run
+    size_t checks_run;
+    /// checks, that were skipped because of verification level
+    size_t checks_skipped;
+    /// reallocations of data
+    size_t reallocs;
+    /// bytes, that were copied by reallocations, which moved data
+    size_t bytes_copied;
+
+    ON_STATS
+    (
+        /// pushed elements
+        size_t pushes;
+        /// popped elements
+        size_t pops;
+        /// dumps
+        size_t dumps;
+        /// ticks of checks
+        uint64_t check_ticks;
+        /// ticks of reallocations
+        uint64_t realloc_ticks;
+    )
+};
+
 /// @brief Stack structure
 struct Stack
 {
@@ -66,23 +257,68 @@ struct Stack
         canary_t stack_prefix;
     )
 
+    /// data allocator
+    const StackAllocator* allocator;
+
     /// stack data
     elem_t* data;
     /// stack size
     size_t size;
     /// stack capacity
     size_t capacity;
+    /// push is done inline, while size is less (capacity for stack with fast path, 0 otherwise)
+    size_t fast_push_limit;
+    /// pop is done inline, while size is greater (stack can not shrink after it, SIZE_MAX for stack without fast path)
+    size_t fast_pop_limit;
     /// stack status (0 if everything is fine)
     int status;
+    /// write sequence (odd, while stack function changes stack, background verifier copies stack only when it is even)
+    unsigned int write_seq;
+
+    /// verification level
+    StackVerifyLevel verify_level;
+    /// amount of operations between checks (VERIFY_SAMPLED level)
+    size_t verify_period;
+    /// stack is registered for background verifier, even if verifier is not running, when it is created
+    bool verify_background;
+    /// position of stack in verifier registry + 1 (0 if stack is not registered), registry changes it under its lock
+    size_t registry_slot;
+    /// stack counters
+    StackStats stats;
+
+    /// growth policy
+    GrowthPolicy growth;
+    /// operations since last realloc
+    size_t ops_since_realloc;
+    /// size after last slow function (inline operations since it are counted by size movement)
+    size_t fast_size_mark;
+
+    /// first slot, that was poisoned by pop since last check
+    size_t poison_dirty_left;
+    /// slot after last slot, that was poisoned by pop since last check
+    size_t poison_dirty_right;
+    /// next empty slot to be verified by poison verification
+    size_t poison_scrub_pos;
 
     ON_HASH
     (
         /// hash function
         hash_f hash_func;
-        /// data hash
+        /// data hash (xor of position-aware slot hashes, updated on every write)
         hash_t data_hash;
         /// stack hash
         hash_t stack_hash;
+        /// next slot to be folded into hash_scrub_acc by data hash verification
+        size_t hash_scrub_pos;
+        /// data hash of slots [0, hash_scrub_pos), as seen by verification
+        hash_t hash_scrub_acc;
+    )
+
+    ON_INLINE
+    (
+        /// inline block (data canaries and STACK_INLINE_CAPACITY elements), data is kept here,
+        /// while capacity is not greater than STACK_INLINE_CAPACITY (it is not covered by stack hash)
+        alignas(canary_t) char inline_block[STACK_INLINE_BLOCK_SIZE];
     )
 
     ON_CANARY
@@ -125,11 +361,17 @@ enum StackCondition
 /************************************************************//**
  * @brief Creates stack
  *
+ * Fields hash_func, verify_level, verify_period, verify_background, growth and allocator can be set
+ * before call, zero value means default one (GUARD_ALLOCATOR in GUARD_PAGE_PROTECT mode, MALLOC_ALLOCATOR otherwise).
+ * Capacity of stack with GUARD_ALLOCATOR is rounded up, so buffer takes whole pages.
+ * Stack with inline elements (STACK_INLINE_CAPACITY) does not allocate, while capacity fits in them.
+ * Stack is registered for background verifier, if verifier runs or verify_background is set
+ *
  * @param[in] stk stack pointer
  * @param[in] capacity stack capacity
  * @return int error code
  *************************************************************/
-int StackCtor(Stack_t* stk, size_t capacity = MIN_CAPACITY);
+int StackCtor(Stack_t* stk, size_t capacity = DEFAULT_CAPACITY);
 
 /************************************************************//**
  * @brief Destroys stack
@@ -139,26 +381,102 @@ int StackCtor(Stack_t* stk, size_t capacity = MIN_CAPACITY);
  ************************************************************/
 int StackDtor(Stack_t* stk);
 
+/************************************************************//**
+ * @brief Pushes element in stack with checks and realloc (StackPush calls it, when its fast path can not be taken)
+ *
+ * @param[in] stk stack pointer
+ * @param[in] value element
+ * @return int error code
+ ************************************************************/
+int StackPushSlow(Stack_t* stk, elem_t value);
+
+/************************************************************//**
+ * @brief Pops element from stack with checks and realloc (StackPop calls it, when its fast path can not be taken)
+ *
+ * @param[in] stk stack pointer
+ * @param[out] ret_value popped element
+ * @return int error code
+ ************************************************************/
+int StackPopSlow(Stack_t* stk, elem_t* ret_value);
+
 /************************************************************//**
  * @brief Pushes element in stack
  *
+ * Stack with VERIFY_OFF level in build without protections (STACK_FAST_PATH) pushes in spare capacity inline,
+ * other pushes go to StackPushSlow
+ *
  * @param[in] stk stack pointer
  * @param[in] value element
  * @return int error code
  ************************************************************/
-int StackPush(Stack_t* stk, elem_t value);
+inline int StackPush(Stack_t* stk, elem_t value)
+{
+    assert(stk);
+
+#if STACK_FAST_PATH
+    if (stk->size < stk->fast_push_limit)
+    {
+        stk->data[stk->size++] = value;
+        return (int) ERRORS::NONE;
+    }
+#endif
+
+    return StackPushSlow(stk, value);
+}
 
 /************************************************************//**
  * @brief Pops element from stack
  *
+ * Stack with VERIFY_OFF level in build without protections (STACK_FAST_PATH) pops inline,
+ * while stack can not shrink after pop, other pops go to StackPopSlow
+ *
  * @param[in] stk stack pointer
  * @param[out] ret_value popped element
  * @return int error code
  ************************************************************/
-int StackPop(Stack_t* stk, elem_t* ret_value);
+inline int StackPop(Stack_t* stk, elem_t* ret_value)
+{
+    assert(stk);
+    assert(ret_value);
+
+#if STACK_FAST_PATH
+    if (stk->size > stk->fast_pop_limit)
+    {
+        elem_t* slot = stk->data + --stk->size;
+
+        *ret_value = *slot;
+        *slot      = STACK_POISON;
+
+        return (int) ERRORS::NONE;
+    }
+#endif
+
+    return StackPopSlow(stk, ret_value);
+}
+
+/************************************************************//**
+ * @brief Pushes elements in stack (values[count - 1] becomes top)
+ *
+ * @param[in] stk stack pointer
+ * @param[in] values elements
+ * @param[in] count amount of elements
+ * @return int error code
+ ************************************************************/
+int StackPushN(Stack_t* stk, const elem_t* values, size_t count);
+
+/************************************************************//**
+ * @brief Pops elements from stack (top goes to ret_values[count - 1])
+ *
+ * @param[in] stk stack pointer
+ * @param[out] ret_values popped elements
+ * @param[in] count amount of elements
+ * @return int error code
+ ************************************************************/
+int StackPopN(Stack_t* stk, elem_t* ret_values, size_t count);
 
 /************************************************************//**
  * @brief Prints info about stack in output stream
+ * (if dump file is opened by OpenDumpFile, stack goes there in binary form and stream gets reference to it)
  *
  * @param[in] fp output stream
  * @param[in] stk stack pointer
@@ -170,7 +488,68 @@ int StackPop(Stack_t* stk, elem_t* ret_value);
 int StackDump(FILE* fp, const void* stk, const char* func, const char* file, const int line);
 
 /************************************************************//**
- * @brief Verifies stack
+ * @brief Writes binary dump record of stack (header and raw data buffer, see stack_dump.h) in output stream
+ *
+ * @param[in] fp binary output stream
+ * @param[in] stk stack pointer
+ * @param[in] func function, where dump called
+ * @param[in] file file, where dump called
+ * @param[in] line line, where dump called
+ * @return int error code
+ ************************************************************/
+int StackDumpBinary(FILE* fp, const void* stk, const char* func, const char* file, const int line);
+
+/************************************************************//**
+ * @brief Attaches stack, that was copied or mapped from other process, to its data buffer
+ *
+ * Stack canaries and stack hash are verified with stored values first, then pointers (data,
+ * allocator, hash function) are replaced and stack gets full check
+ *
+ * @param[in] stk stack pointer
+ * @param[in] block data buffer (the same block, that allocator gave to stack, with data canaries),
+ * it is not used (and can be nullptr), if stack keeps data in inline block
+ * @param[in] block_size size of block
+ * @param[in] allocator allocator, that owns block now
+ * @param[in] hash_func hash function (nullptr for default one), it must be the same as before
+ * @return int stack condition code (stack keeps no data, if block does not fit it)
+ ************************************************************/
+int StackRebase(Stack_t* stk, void* block, size_t block_size, const StackAllocator* allocator,
+                hash_f hash_func = nullptr);
+
+/// @brief copy of stack and its data, that is taken while stack can be changed by other thread
+struct StackSnapshot
+{
+    /// copy of stack (its data is in block)
+    Stack_t stk;
+    /// copy of data buffer
+    void* block;
+    /// size of block
+    size_t block_size;
+};
+
+/************************************************************//**
+ * @brief Copies stack, that can be changed by other thread (buffer of stack must not be freed during call,
+ * StackRealloc and StackDtor provide it by VerifierHold and registry lock)
+ *
+ * Stack header is copied and verified first (canaries and stack hash), then data is copied, and copy
+ * gets pointer to it. If stack was changed during copy, nothing is verified
+ *
+ * @param[in] stk stack pointer
+ * @param[out] snapshot snapshot (its block is reused by next calls)
+ * @return int error code (WOULD_BLOCK, if stack was being changed), condition of header is in snapshot->stk.status,
+ * if it is OK, snapshot->stk has data and can be verified by StackOk
+ ************************************************************/
+int StackTakeSnapshot(const Stack_t* stk, StackSnapshot* snapshot);
+
+/************************************************************//**
+ * @brief Frees snapshot block
+ *
+ * @param[in] snapshot snapshot
+ ************************************************************/
+void StackSnapshotDtor(StackSnapshot* snapshot);
+
+/************************************************************//**
+ * @brief Verifies stack (full check, data hash is recounted over whole buffer)
  *
  * @param[in] stk stack pointer
  * @return int stack condition code
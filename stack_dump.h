@@ -0,0 +1,98 @@
+#ifndef __STACK_DUMP_H_
+#define __STACK_DUMP_H_
+
+#include <stdint.h>
+
+/*! \file
+* \brief Contains binary stack dump format
+*
+* Binary dump file is a sequence of records. Every record is StackDumpHeader, then func_len bytes of function name,
+* file_len bytes of file name and data_count raw elements (elem_size bytes each) of stack buffer.
+* Fields have fixed size, so stackdump-decode reads dumps of any protection mode (flags tell, which fields are valid).
+*/
+
+/// binary dump record signature
+static const char STACK_DUMP_MAGIC[8] = {'S', 'T', 'K', 'D', 'U', 'M', 'P', '\0'};
+
+/// binary dump format version
+static const uint32_t STACK_DUMP_VERSION = 1;
+
+/// extension of binary dump file
+static const char STACK_DUMP_EXTENSION[] = ".stkdump";
+
+/// @brief protections, that were on in dumped stack
+enum StackDumpFlags
+{
+    /// canary fields are valid
+    DUMP_CANARY = 1 << 0,
+    /// hash fields are valid
+    DUMP_HASH   = 1 << 1
+};
+
+/// @brief header of binary dump record
+struct StackDumpHeader
+{
+    /// STACK_DUMP_MAGIC
+    char     magic[8];
+    /// STACK_DUMP_VERSION
+    uint32_t version;
+    /// StackDumpFlags
+    uint32_t flags;
+    /// size of element
+    uint32_t elem_size;
+    /// stack status (StackCondition bits)
+    int32_t  status;
+    /// verification level
+    int32_t  verify_level;
+    /// line, where dump called
+    int32_t  line;
+    /// dump time (seconds since epoch)
+    int64_t  time;
+
+    /// stack address
+    uint64_t stack_addr;
+    /// data address
+    uint64_t data_addr;
+    /// hash function address
+    uint64_t hash_func_addr;
+
+    /// stack size
+    uint64_t size;
+    /// stack capacity
+    uint64_t capacity;
+    /// checks, that were run
+    uint64_t checks_run;
+    /// checks, that were skipped
+    uint64_t checks_skipped;
+    /// reallocations of data
+    uint64_t reallocs;
+    /// bytes, that were copied by reallocations
+    uint64_t bytes_copied;
+
+    /// stack prefix canary
+    uint64_t stack_prefix;
+    /// stack postfix canary
+    uint64_t stack_postfix;
+    /// data prefix canary
+    uint64_t data_prefix;
+    /// data postfix canary
+    uint64_t data_postfix;
+
+    /// expected stack hash
+    uint32_t stack_hash;
+    /// expected data hash
+    uint32_t data_hash;
+    /// current stack hash
+    uint32_t stack_current;
+    /// current data hash
+    uint32_t data_current;
+
+    /// length of function name
+    uint32_t func_len;
+    /// length of file name
+    uint32_t file_len;
+    /// amount of elements after names (whole buffer, poisoned slots too)
+    uint64_t data_count;
+};
+
+#endif
@@ -0,0 +1,331 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "stack_file.h"
+#include "log_funcs.h"
+#include "stack_verifier.h"
+
+static_assert(sizeof(StackFileHeader) <= STACK_FILE_HEADER_SIZE, "stack header does not fit in file header");
+
+// ============= STATIC FUNCS ===============
+static void* FileAlloc(void* ctx, size_t size);
+static void* FileRealloc(void* ctx, void* ptr, size_t old_size, size_t new_size);
+static void  FileFree(void* ctx, void* ptr, size_t size);
+
+static int CreateStack(StackFile* file, size_t capacity);
+static int LoadStack(StackFile* file, const size_t file_size);
+static int VerifyHeader(const StackFileHeader* header, const size_t file_size);
+static void UnmapFile(StackFile* file);
+static inline uint32_t GetProtectionFlags();
+//============================================
+
+int StackFileOpen(StackFile* file, const char* path, size_t capacity)
+{
+    assert(file);
+    assert(path);
+
+    *file = {};
+
+    file->allocator = {FileAlloc, FileRealloc, FileFree, file};
+
+    file->fd = open(path, O_RDWR | O_CREAT, 0644);
+
+    if (file->fd < 0)
+        return (int) ERRORS::OPEN_FILE;
+
+    struct stat file_stat = {};
+
+    if (fstat(file->fd, &file_stat) != 0)
+    {
+        UnmapFile(file);
+        return (int) ERRORS::READ_FILE;
+    }
+
+    size_t file_size = (size_t) file_stat.st_size;
+
+    if (file_size == 0 && ftruncate(file->fd, STACK_FILE_HEADER_SIZE) != 0)
+    {
+        UnmapFile(file);
+        return (int) ERRORS::ALLOCATE_MEMORY;
+    }
+
+    if (file_size != 0 && file_size < STACK_FILE_HEADER_SIZE)
+    {
+        PrintLog("STACK FILE %s IS TOO SHORT (%zu BYTES)\n", path, file_size);
+        UnmapFile(file);
+        return (int) ERRORS::INVALID_STACK;
+    }
+
+    void* header = mmap(nullptr, STACK_FILE_HEADER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+
+    if (header == MAP_FAILED)
+    {
+        UnmapFile(file);
+        return (int) ERRORS::ALLOCATE_MEMORY;
+    }
+
+    file->header = (StackFileHeader*) header;
+
+    // file, that is new or keeps destroyed stack, gets new stack (stack with inline data has no data buffer),
+    // other file is written only after its header is verified
+    bool destroyed = file_size != 0 && VerifyHeader(file->header, file_size) == OK &&
+                     file->header->data_size == 0 && file->header->stk.capacity == 0;
+
+    int error = (file_size == 0 || destroyed) ? CreateStack(file, capacity) : LoadStack(file, file_size);
+
+    if (error != (int) ERRORS::NONE)
+    {
+        PrintLog("CAN NOT OPEN STACK FILE %s (ERROR %d)\n", path, error);
+        UnmapFile(file);
+    }
+
+    return error;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int StackFileSync(StackFile* file)
+{
+    assert(file);
+    assert(file->header);
+
+    if (msync(file->header, STACK_FILE_HEADER_SIZE, MS_SYNC) != 0)
+        return (int) ERRORS::PRINT_DATA;
+
+    if (file->data != nullptr && msync(file->data, file->data_size, MS_SYNC) != 0)
+        return (int) ERRORS::PRINT_DATA;
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int StackFileClose(StackFile* file)
+{
+    assert(file);
+
+    int error = (file->header != nullptr) ? StackFileSync(file) : (int) ERRORS::NONE;
+
+    UnmapFile(file);
+
+    return error;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static int CreateStack(StackFile* file, size_t capacity)
+{
+    assert(file);
+
+    StackFileHeader* header = file->header;
+
+    *header = {};
+
+    memcpy(header->magic, STACK_FILE_MAGIC, sizeof(header->magic));
+
+    header->version    = STACK_FILE_VERSION;
+    header->flags      = GetProtectionFlags();
+    header->stack_size = sizeof(Stack_t);
+    header->elem_size  = sizeof(elem_t);
+
+    header->stk.allocator = &file->allocator;
+
+    file->stk = &header->stk;
+
+    return StackCtor(file->stk, capacity);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static int LoadStack(StackFile* file, const size_t file_size)
+{
+    assert(file);
+
+    StackFileHeader* header = file->header;
+
+    int condition = VerifyHeader(header, file_size);
+
+    if (condition != OK)
+    {
+        PrintLog("INVALID STACK FILE HEADER (CONDITION %d)\n", condition);
+        return (int) ERRORS::INVALID_STACK;
+    }
+
+    void* data = nullptr;
+
+    // stack with inline data keeps it in header
+    if (header->data_size != 0)
+    {
+        data = mmap(nullptr, header->data_size, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, STACK_FILE_HEADER_SIZE);
+
+        if (data == MAP_FAILED)
+            return (int) ERRORS::ALLOCATE_MEMORY;
+
+        file->data      = data;
+        file->data_size = header->data_size;
+    }
+
+    // rebase resets registry slot, that was given to previous owner of stack
+    file->stk = &header->stk;
+
+    condition = StackRebase(file->stk, data, header->data_size, &file->allocator);
+
+    if (condition != OK)
+    {
+        if (header->stk.data != nullptr)
+            STACK_DUMP(&header->stk);
+        else
+            PrintLog("STACK IN FILE DOES NOT FIT ITS DATA (CONDITION %d)\n", condition);
+
+        return (int) ERRORS::INVALID_STACK;
+    }
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static int VerifyHeader(const StackFileHeader* header, const size_t file_size)
+{
+    assert(header);
+
+    int condition = OK;
+
+    if (memcmp(header->magic, STACK_FILE_MAGIC, sizeof(STACK_FILE_MAGIC)) != 0 ||
+        header->version != STACK_FILE_VERSION)
+        condition |= INVALID_DATA;
+
+    // stack of other build can not be read
+    if (header->flags != GetProtectionFlags() || header->stack_size != sizeof(Stack_t) ||
+        header->elem_size != sizeof(elem_t))
+        condition |= INVALID_DATA;
+
+    if (header->data_size > file_size - STACK_FILE_HEADER_SIZE)
+        condition |= INVALID_CAPACITY;
+
+    return condition;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void UnmapFile(StackFile* file)
+{
+    assert(file);
+
+    // stack is kept in file, so it is not destroyed, but verifier must not read it after unmap
+    // (stk is set only after stack was created or rebased, before that its registry slot is not ours)
+    if (file->stk != nullptr)
+        StackRegistryRemove(file->stk);
+
+    if (file->data != nullptr)
+        munmap(file->data, file->data_size);
+
+    if (file->header != nullptr)
+        munmap(file->header, STACK_FILE_HEADER_SIZE);
+
+    if (file->fd >= 0)
+        close(file->fd);
+
+    file->fd        = -1;
+    file->header    = nullptr;
+    file->data      = nullptr;
+    file->data_size = 0;
+    file->stk       = nullptr;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void* FileAlloc(void* ctx, size_t size)
+{
+    assert(ctx);
+
+    StackFile* file = (StackFile*) ctx;
+
+    if (file->data != nullptr || size == 0)
+        return nullptr;
+
+    if (ftruncate(file->fd, (off_t) (STACK_FILE_HEADER_SIZE + size)) != 0)
+        return nullptr;
+
+    void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, STACK_FILE_HEADER_SIZE);
+
+    if (data == MAP_FAILED)
+        return nullptr;
+
+    file->data              = data;
+    file->data_size         = size;
+    file->header->data_size = size;
+
+    return data;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void* FileRealloc(void* ctx, void* ptr, size_t old_size, size_t new_size)
+{
+    assert(ctx);
+
+    StackFile* file = (StackFile*) ctx;
+
+    assert(ptr == file->data);
+    assert(old_size == file->data_size);
+
+    // file grows before mapping, and shrinks after it, so mapping never has pages without file behind them
+    if (new_size > old_size && ftruncate(file->fd, (off_t) (STACK_FILE_HEADER_SIZE + new_size)) != 0)
+        return nullptr;
+
+    void* data = mremap(ptr, old_size, new_size, MREMAP_MAYMOVE);
+
+    if (data == MAP_FAILED)
+    {
+        if (new_size > old_size && ftruncate(file->fd, (off_t) (STACK_FILE_HEADER_SIZE + old_size)) != 0)
+            PrintLog("CAN NOT SHRINK STACK FILE BACK TO %zu BYTES\n", STACK_FILE_HEADER_SIZE + old_size);
+
+        return nullptr;
+    }
+
+    // tail, that was not cut off, does not break file (only its beginning is read)
+    if (new_size < old_size && ftruncate(file->fd, (off_t) (STACK_FILE_HEADER_SIZE + new_size)) != 0)
+        PrintLog("CAN NOT SHRINK STACK FILE TO %zu BYTES\n", STACK_FILE_HEADER_SIZE + new_size);
+
+    file->data              = data;
+    file->data_size         = new_size;
+    file->header->data_size = new_size;
+
+    return data;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void FileFree(void* ctx, void* ptr, size_t size)
+{
+    assert(ctx);
+
+    StackFile* file = (StackFile*) ctx;
+
+    if (ptr == nullptr)
+        return;
+
+    assert(ptr == file->data);
+
+    munmap(ptr, size);
+
+    if (ftruncate(file->fd, STACK_FILE_HEADER_SIZE) != 0)
+        PrintLog("CAN NOT SHRINK STACK FILE TO %zu BYTES\n", STACK_FILE_HEADER_SIZE);
+
+    file->data              = nullptr;
+    file->data_size         = 0;
+    file->header->data_size = 0;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline uint32_t GetProtectionFlags()
+{
+    return (CANARY_PROTECT ? 1 : 0) | (HASH_PROTECT ? 2 : 0);
+}
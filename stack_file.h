@@ -0,0 +1,94 @@
+#ifndef __STACK_FILE_H_
+#define __STACK_FILE_H_
+
+#include <stdint.h>
+
+#include "stack.h"
+
+/*! \file
+* \brief Contains file-backed stack: stack header and data buffer live in mmaped file
+*
+* File is StackFileHeader (one STACK_FILE_HEADER_SIZE page, Stack_t is inside) and data buffer of stack right after it.
+* Stack works with mapped memory directly, so there is no serialization: reopened file gives the same stack
+* after full check (canaries, stack hash, data hash and poison are verified). Data buffer grows and shrinks
+* by ftruncate and mremap. Hash function is not stored, stack has to use default one.
+*/
+
+/// size of file header (data buffer starts after it)
+static const size_t STACK_FILE_HEADER_SIZE = 4096;
+
+/// stack file signature
+static const char STACK_FILE_MAGIC[8] = {'S', 'T', 'K', 'F', 'I', 'L', 'E', '\0'};
+
+/// stack file format version
+static const uint32_t STACK_FILE_VERSION = 1;
+
+/// @brief header of stack file
+struct StackFileHeader
+{
+    /// STACK_FILE_MAGIC
+    char     magic[8];
+    /// STACK_FILE_VERSION
+    uint32_t version;
+    /// protections of stack (layout of Stack_t depends on them)
+    uint32_t flags;
+    /// size of Stack_t
+    uint32_t stack_size;
+    /// size of element
+    uint32_t elem_size;
+    /// size of data buffer (0, if stack is destroyed or keeps data in its inline block)
+    uint64_t data_size;
+
+    /// stack
+    Stack_t  stk;
+};
+
+/// @brief opened stack file
+struct StackFile
+{
+    /// allocator of stack data (it resizes file)
+    StackAllocator allocator;
+
+    /// file descriptor
+    int fd;
+    /// mapped header
+    StackFileHeader* header;
+    /// mapped data buffer
+    void* data;
+    /// size of mapped data buffer
+    size_t data_size;
+
+    /// stack (it is inside mapped header and valid until StackFileClose)
+    Stack_t* stk;
+};
+
+/************************************************************//**
+ * @brief Opens stack file, creates new stack in it, if file is empty or does not exist
+ *
+ * Fields of file->stk (hash function, verification level...) can not be set before call,
+ * stack in new file has default ones
+ *
+ * @param[in] file stack file pointer
+ * @param[in] path file path
+ * @param[in] capacity capacity of new stack
+ * @return int error code (ERRORS::INVALID_STACK, if stored stack does not pass check)
+ ************************************************************/
+int StackFileOpen(StackFile* file, const char* path, size_t capacity = DEFAULT_CAPACITY);
+
+/************************************************************//**
+ * @brief Writes stack to disk (msync)
+ *
+ * @param[in] file stack file pointer
+ * @return int error code
+ ************************************************************/
+int StackFileSync(StackFile* file);
+
+/************************************************************//**
+ * @brief Writes stack to disk and closes stack file (stack stays in file)
+ *
+ * @param[in] file stack file pointer
+ * @return int error code
+ ************************************************************/
+int StackFileClose(StackFile* file);
+
+#endif
@@ -0,0 +1,229 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <inttypes.h>
+#include <thread>
+#include <mutex>
+#include <chrono>
+
+#include "stack_stats.h"
+#include "log_funcs.h"
+
+/// @brief counters of one thread (only its thread writes them)
+struct StatsBlock
+{
+    /// counters in ticks
+    StackGlobalStats stats;
+    /// next block
+    StatsBlock* next;
+};
+
+/// lock of block list and reset base
+static std::mutex STATS_LOCK;
+
+/// blocks of all threads, that counted anything (blocks are kept after thread exit)
+static StatsBlock* BLOCKS = nullptr;
+
+/// sum of blocks at last reset
+static StackGlobalStats RESET_BASE = {};
+
+static thread_local StatsBlock* THREAD_BLOCK = nullptr;
+
+static const char* COUNTER_NAMES[STATS_COUNTERS] = {"PUSHES", "POPS", "REALLOCS", "BYTES COPIED", "REALLOC NS",
+                                                    "CHECKS", "CHECK NS", "DUMPS", "DUMP NS"};
+
+static const char* OP_NAMES[STATS_OPS] = {"PUSH", "POP"};
+
+/// counter, that is increased by latency record of operation
+static const StatsCounter OP_COUNTERS[STATS_OPS] = {STATS_PUSHES, STATS_POPS};
+
+/// how long tick counter is compared with monotonic clock
+static const std::chrono::milliseconds CALIBRATION_TIME(10);
+
+// ============= STATIC FUNCS ===============
+static StatsBlock* GetThreadBlock();
+static void SumBlocks(StackGlobalStats* sum);
+static inline void AddToCell(uint64_t* cell, uint64_t value);
+static double CalibrateTicks();
+//============================================
+
+void StatsAdd(StatsCounter counter, uint64_t value)
+{
+    assert(counter < STATS_COUNTERS);
+
+    AddToCell(&GetThreadBlock()->stats.counters[counter], value);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void StatsRecord(StatsOp op, uint64_t start)
+{
+    assert(op < STATS_OPS);
+
+    StatsBlock* block = GetThreadBlock();
+
+    AddToCell(&block->stats.counters[OP_COUNTERS[op]], 1);
+
+    if (start == 0)
+        return;
+
+    uint64_t ticks = ReadTicks() - start;
+
+    size_t bucket = (ticks == 0) ? 0 : (size_t) (63 - __builtin_clzll(ticks));
+
+    if (bucket >= STATS_HIST_BUCKETS)
+        bucket = STATS_HIST_BUCKETS - 1;
+
+    AddToCell(&block->stats.latency[op][bucket], 1);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void GetStackStats(StackGlobalStats* stats)
+{
+    assert(stats);
+
+    StackGlobalStats sum = {};
+
+    {
+        std::lock_guard<std::mutex> guard(STATS_LOCK);
+
+        SumBlocks(&sum);
+
+        for (size_t i = 0; i < STATS_COUNTERS; i++)
+            sum.counters[i] -= RESET_BASE.counters[i];
+
+        for (size_t op = 0; op < STATS_OPS; op++)
+            for (size_t i = 0; i < STATS_HIST_BUCKETS; i++)
+                sum.latency[op][i] -= RESET_BASE.latency[op][i];
+    }
+
+    sum.counters[STATS_REALLOC_NS] = TicksToNs(sum.counters[STATS_REALLOC_NS]);
+    sum.counters[STATS_CHECK_NS]   = TicksToNs(sum.counters[STATS_CHECK_NS]);
+    sum.counters[STATS_DUMP_NS]    = TicksToNs(sum.counters[STATS_DUMP_NS]);
+
+    *stats = sum;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void ResetStackStats()
+{
+    std::lock_guard<std::mutex> guard(STATS_LOCK);
+
+    // counters of other threads can not be written, so later reads subtract current sum
+    SumBlocks(&RESET_BASE);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void PrintStackStats()
+{
+    StackGlobalStats stats = {};
+
+    GetStackStats(&stats);
+
+    PrintLog("\n>>>>>>>>>>STACK STATS<<<<<<<<<\n");
+
+    for (size_t i = 0; i < STATS_COUNTERS; i++)
+        PrintLog("%-20s > %" PRIu64 "\n", COUNTER_NAMES[i], stats.counters[i]);
+
+    for (size_t op = 0; op < STATS_OPS; op++)
+    {
+        PrintLog("%s LATENCY (NS)\n", OP_NAMES[op]);
+
+        for (size_t i = 0; i < STATS_HIST_BUCKETS; i++)
+        {
+            if (stats.latency[op][i] == 0)
+                continue;
+
+            uint64_t low  = (i == 0) ? 0 : TicksToNs((uint64_t) 1 << i);
+            uint64_t high = TicksToNs((uint64_t) 1 << (i + 1));
+
+            PrintLog("[%8" PRIu64 ", %8" PRIu64 ") > %" PRIu64 "\n", low, high, stats.latency[op][i]);
+        }
+    }
+
+    PrintLog(">>>>>>>>STACK STATS END<<<<<<<\n\n");
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+uint64_t TicksToNs(uint64_t ticks)
+{
+    static const double ticks_per_ns = CalibrateTicks();
+
+    return (uint64_t) ((double) ticks / ticks_per_ns);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static StatsBlock* GetThreadBlock()
+{
+    if (THREAD_BLOCK != nullptr)
+        return THREAD_BLOCK;
+
+    StatsBlock* block = (StatsBlock*) calloc(1, sizeof(StatsBlock));
+
+    // counters are lost, if block can not be allocated
+    static StatsBlock lost_block = {};
+
+    if (block == nullptr)
+        return &lost_block;
+
+    std::lock_guard<std::mutex> guard(STATS_LOCK);
+
+    block->next  = BLOCKS;
+    BLOCKS       = block;
+    THREAD_BLOCK = block;
+
+    return block;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void SumBlocks(StackGlobalStats* sum)
+{
+    assert(sum);
+
+    *sum = {};
+
+    for (StatsBlock* block = BLOCKS; block != nullptr; block = block->next)
+    {
+        for (size_t i = 0; i < STATS_COUNTERS; i++)
+            sum->counters[i] += __atomic_load_n(&block->stats.counters[i], __ATOMIC_RELAXED);
+
+        for (size_t op = 0; op < STATS_OPS; op++)
+            for (size_t i = 0; i < STATS_HIST_BUCKETS; i++)
+                sum->latency[op][i] += __atomic_load_n(&block->stats.latency[op][i], __ATOMIC_RELAXED);
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline void AddToCell(uint64_t* cell, uint64_t value)
+{
+    // cell has only one writer, so it is not locked, store is atomic only for readers
+    __atomic_store_n(cell, *cell + value, __ATOMIC_RELAXED);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static double CalibrateTicks()
+{
+#if STATS_X86
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    uint64_t start = ReadTicks();
+
+    std::this_thread::sleep_for(CALIBRATION_TIME);
+
+    uint64_t ticks = ReadTicks() - start;
+    long long ns   = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                          start_time).count();
+
+    return (double) ticks / (double) ns;
+
+#else
+    // ticks are ns of monotonic clock
+    return 1.0;
+#endif
+}
@@ -0,0 +1,146 @@
+#ifndef __STACK_STATS_H_
+#define __STACK_STATS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define STATS_X86 1
+
+#else
+#define STATS_X86 0
+#endif
+
+/*! \file
+* \brief Contains global stack counters and latency histograms (STACK_STATS mode)
+*
+* Every thread adds to its own block of counters (plain stores, no atomic read-modify-write), so counting costs
+* a few ns per operation. Blocks of all threads are summed, when counters are read. Time is counted in ticks
+* of rdtsc (of monotonic clock on other CPUs) and is given in ns.
+*/
+
+/// latency of every STATS_LATENCY_SAMPLE-th push and pop is recorded (tick counter is too slow to read it every time)
+static const size_t STATS_LATENCY_SAMPLE = 16;
+/// amount of log2 buckets of latency histograms (bucket i keeps latencies in [2^i, 2^(i+1)) ticks)
+static const size_t STATS_HIST_BUCKETS = 40;
+
+/// @brief global counters
+enum StatsCounter
+{
+    /// pushed elements
+    STATS_PUSHES,
+    /// popped elements
+    STATS_POPS,
+    /// reallocations of data
+    STATS_REALLOCS,
+    /// bytes, that were copied by reallocations, which moved data
+    STATS_BYTES_COPIED,
+    /// time of reallocations
+    STATS_REALLOC_NS,
+    /// checks (inline ones and StackOk)
+    STATS_CHECKS,
+    /// time of checks
+    STATS_CHECK_NS,
+    /// dumps
+    STATS_DUMPS,
+    /// time of dumps
+    STATS_DUMP_NS,
+
+    /// amount of counters
+    STATS_COUNTERS
+};
+
+/// @brief operations with latency histograms
+enum StatsOp
+{
+    /// StackPush
+    STATS_PUSH,
+    /// StackPop
+    STATS_POP,
+
+    /// amount of operations
+    STATS_OPS
+};
+
+/// @brief global counters of all threads (time counters are in ns)
+struct StackGlobalStats
+{
+    /// counters
+    uint64_t counters[STATS_COUNTERS];
+    /// latency histograms of operations
+    uint64_t latency[STATS_OPS][STATS_HIST_BUCKETS];
+};
+
+/************************************************************//**
+ * @brief Reads tick counter
+ *
+ * @return uint64_t ticks
+ ************************************************************/
+static inline uint64_t ReadTicks()
+{
+#if STATS_X86
+    return __rdtsc();
+
+#else
+    timespec now = {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+#endif
+}
+
+/************************************************************//**
+ * @brief Reads tick counter, if operation is sampled
+ *
+ * @param[in] ops amount of previous operations
+ * @return uint64_t ticks (0, if operation is not sampled)
+ ************************************************************/
+static inline uint64_t SampleTicks(size_t ops)
+{
+    return (ops % STATS_LATENCY_SAMPLE == 0) ? ReadTicks() : 0;
+}
+
+/************************************************************//**
+ * @brief Adds value to global counter of this thread
+ *
+ * @param[in] counter counter
+ * @param[in] value value (ticks for time counters)
+ ************************************************************/
+void StatsAdd(StatsCounter counter, uint64_t value);
+
+/************************************************************//**
+ * @brief Counts operation, also adds its latency to histogram of this thread
+ *
+ * @param[in] op operation
+ * @param[in] start ticks, when operation was started (0, if operation is not sampled)
+ ************************************************************/
+void StatsRecord(StatsOp op, uint64_t start);
+
+/************************************************************//**
+ * @brief Gives global counters (since last ResetStackStats)
+ *
+ * @param[out] stats counters
+ ************************************************************/
+void GetStackStats(StackGlobalStats* stats);
+
+/************************************************************//**
+ * @brief Resets global counters
+ ************************************************************/
+void ResetStackStats();
+
+/************************************************************//**
+ * @brief Prints global counters and latency histograms to log
+ ************************************************************/
+void PrintStackStats();
+
+/************************************************************//**
+ * @brief Converts ticks to ns (tick counter is calibrated by first call)
+ *
+ * @param[in] ticks ticks
+ * @return uint64_t ns
+ ************************************************************/
+uint64_t TicksToNs(uint64_t ticks);
+
+#endif
@@ -0,0 +1,381 @@
+#include <stdlib.h>
+#include <assert.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "stack_verifier.h"
+#include "stack.h"
+#include "log_funcs.h"
+
+/// @brief registered stack
+struct RegistryEntry
+{
+    /// stack
+    Stack_t* stk;
+    /// corruption of stack was reported
+    bool reported;
+};
+
+/// @brief registry of stacks
+struct StackRegistry
+{
+    /// lock of entries (verifier holds it, while it copies stack)
+    std::mutex lock;
+    /// registered stacks
+    RegistryEntry* entries;
+    /// amount of registered stacks
+    size_t size;
+    /// capacity of entries
+    size_t capacity;
+};
+
+/// @brief background verifier state
+struct Verifier
+{
+    /// verifier thread
+    std::thread thread;
+    /// lock of fields below
+    std::mutex lock;
+    /// wakes verifier thread
+    std::condition_variable wake;
+    /// verifier has to finish
+    bool stop;
+    /// period of passes
+    std::chrono::milliseconds period;
+    /// function, that gets corrupted stacks
+    corruption_f callback;
+    /// callback context
+    void* ctx;
+
+    /// verifier is running (stacks take registry lock while they reallocate buffer)
+    std::atomic<bool> running;
+
+    /// passes over registry
+    std::atomic<size_t> passes;
+    /// stacks, that were checked
+    std::atomic<size_t> checked;
+    /// stacks, that were skipped, because they were being changed
+    std::atomic<size_t> busy;
+    /// stacks, that were found corrupted
+    std::atomic<size_t> corrupted;
+};
+
+static StackRegistry REGISTRY = {};
+
+static Verifier VERIFIER = {};
+
+/// minimum capacity of registry
+static const size_t REGISTRY_MIN_CAPACITY = 64;
+/// attempts to copy stack, that is being changed, in one pass
+static const size_t SNAPSHOT_ATTEMPTS     = 4;
+/// result of CheckEntry, when stack was not checked (it was being changed or removed)
+static const int NOT_CHECKED              = -1;
+
+// ============= STATIC FUNCS ===============
+static void VerifierLoop();
+static void VerifyRegistry(StackSnapshot* snapshot);
+static int CheckEntry(size_t index, const Stack_t* stk, StackSnapshot* snapshot, bool* has_data);
+static void ReportCorruption(const Stack_t* stk, const StackSnapshot* snapshot, int condition, bool has_data);
+static void MarkReported(const Stack_t* stk, size_t index);
+//============================================
+
+int StackRegistryAdd(Stack_t* stk)
+{
+    assert(stk);
+
+    std::lock_guard<std::mutex> guard(REGISTRY.lock);
+
+    if (stk->registry_slot != 0)
+        return (int) ERRORS::NONE;
+
+    if (REGISTRY.size == REGISTRY.capacity)
+    {
+        size_t capacity = (REGISTRY.capacity == 0) ? REGISTRY_MIN_CAPACITY : REGISTRY.capacity * 2;
+
+        RegistryEntry* entries = (RegistryEntry*) realloc(REGISTRY.entries, capacity * sizeof(RegistryEntry));
+
+        if (entries == nullptr)
+            return (int) ERRORS::ALLOCATE_MEMORY;
+
+        REGISTRY.entries  = entries;
+        REGISTRY.capacity = capacity;
+    }
+
+    REGISTRY.entries[REGISTRY.size++] = {stk, false};
+    stk->registry_slot = REGISTRY.size;
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void StackRegistryRemove(Stack_t* stk)
+{
+    assert(stk);
+
+    // slot of registered stack is changed by other stacks, but it never gets 0 while they do it,
+    // so stack, that is not registered, does not take lock
+    if (stk->registry_slot == 0)
+        return;
+
+    std::lock_guard<std::mutex> guard(REGISTRY.lock);
+
+    size_t index = stk->registry_slot - 1;
+
+    assert(index < REGISTRY.size && REGISTRY.entries[index].stk == stk);
+
+    // last stack takes place of removed one
+    RegistryEntry* last = &REGISTRY.entries[--REGISTRY.size];
+
+    REGISTRY.entries[index]  = *last;
+    last->stk->registry_slot = index + 1;
+
+    stk->registry_slot = 0;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+size_t StackRegistrySize()
+{
+    std::lock_guard<std::mutex> guard(REGISTRY.lock);
+
+    return REGISTRY.size;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int StartVerifier(unsigned period_ms, corruption_f callback, void* ctx)
+{
+    static bool atexit_set = false;
+
+    if (VERIFIER.running.load())
+        return (int) ERRORS::NONE;
+
+    VERIFIER.stop     = false;
+    VERIFIER.period   = std::chrono::milliseconds(period_ms);
+    VERIFIER.callback = callback;
+    VERIFIER.ctx      = ctx;
+
+    // stacks see running verifier before it copies anything
+    VERIFIER.running.store(true);
+
+    VERIFIER.thread = std::thread(VerifierLoop);
+
+    if (!atexit_set)
+    {
+        atexit(StopVerifier);
+        atexit_set = true;
+    }
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void StopVerifier()
+{
+    if (!VERIFIER.running.load())
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(VERIFIER.lock);
+        VERIFIER.stop = true;
+    }
+
+    VERIFIER.wake.notify_one();
+    VERIFIER.thread.join();
+
+    VERIFIER.running.store(false);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+bool VerifierRunning()
+{
+    return VERIFIER.running.load();
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+VerifierStats GetVerifierStats()
+{
+    VerifierStats stats = {};
+
+    stats.passes    = VERIFIER.passes.load(std::memory_order_relaxed);
+    stats.checked   = VERIFIER.checked.load(std::memory_order_relaxed);
+    stats.busy      = VERIFIER.busy.load(std::memory_order_relaxed);
+    stats.corrupted = VERIFIER.corrupted.load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+bool VerifierHold()
+{
+    // write sequence of stack is odd before running flag is read, so either verifier sees stack busy,
+    // or stack sees running verifier and waits for registry lock (pairs with fence in VerifyRegistry)
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (!VERIFIER.running.load(std::memory_order_relaxed))
+        return false;
+
+    REGISTRY.lock.lock();
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+void VerifierRelease(bool held)
+{
+    if (held)
+        REGISTRY.lock.unlock();
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void VerifierLoop()
+{
+    StackSnapshot snapshot = {};
+
+    std::unique_lock<std::mutex> guard(VERIFIER.lock);
+
+    while (!VERIFIER.stop)
+    {
+        guard.unlock();
+
+        VerifyRegistry(&snapshot);
+        VERIFIER.passes.fetch_add(1, std::memory_order_relaxed);
+
+        guard.lock();
+
+        VERIFIER.wake.wait_for(guard, VERIFIER.period, []() { return VERIFIER.stop; });
+    }
+
+    StackSnapshotDtor(&snapshot);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void VerifyRegistry(StackSnapshot* snapshot)
+{
+    assert(snapshot);
+
+    // registry lock is taken for every stack, so stacks are created and destroyed during pass
+    // (stack, that was moved by removal, can be skipped or checked twice in this pass)
+    for (size_t i = 0; ; i++)
+    {
+        const Stack_t* stk = nullptr;
+        bool reported      = false;
+
+        {
+            std::lock_guard<std::mutex> guard(REGISTRY.lock);
+
+            if (i >= REGISTRY.size)
+                break;
+
+            stk      = REGISTRY.entries[i].stk;
+            reported = REGISTRY.entries[i].reported;
+        }
+
+        if (reported)
+            continue;
+
+        bool has_data = false;
+        int condition = CheckEntry(i, stk, snapshot, &has_data);
+
+        if (condition == OK || condition == NOT_CHECKED)
+            continue;
+
+        // inline push and pop do not open write section, so copy could catch one of them in the middle,
+        // corruption is confirmed by second copy
+        condition = CheckEntry(i, stk, snapshot, &has_data);
+
+        if (condition == OK || condition == NOT_CHECKED)
+            continue;
+
+        VERIFIER.corrupted.fetch_add(1, std::memory_order_relaxed);
+
+        ReportCorruption(stk, snapshot, condition, has_data);
+        MarkReported(stk, i);
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static int CheckEntry(size_t index, const Stack_t* stk, StackSnapshot* snapshot, bool* has_data)
+{
+    assert(stk);
+    assert(snapshot);
+    assert(has_data);
+
+    int error = (int) ERRORS::WOULD_BLOCK;
+
+    {
+        std::lock_guard<std::mutex> guard(REGISTRY.lock);
+
+        // stack could be removed, while lock was released
+        if (index >= REGISTRY.size || REGISTRY.entries[index].stk != stk)
+            return NOT_CHECKED;
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        for (size_t attempt = 0; attempt < SNAPSHOT_ATTEMPTS && error == (int) ERRORS::WOULD_BLOCK; attempt++)
+            error = StackTakeSnapshot(stk, snapshot);
+    }
+
+    if (error == (int) ERRORS::WOULD_BLOCK)
+        VERIFIER.busy.fetch_add(1, std::memory_order_relaxed);
+
+    if (error != (int) ERRORS::NONE)
+        return NOT_CHECKED;
+
+    // copy is checked without lock
+    *has_data = snapshot->stk.status == OK;
+
+    int condition = (*has_data) ? StackOk(&snapshot->stk) : snapshot->stk.status;
+
+    VERIFIER.checked.fetch_add(1, std::memory_order_relaxed);
+
+    return condition;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void ReportCorruption(const Stack_t* stk, const StackSnapshot* snapshot, int condition, bool has_data)
+{
+    assert(stk);
+    assert(snapshot);
+
+    PrintLog("BACKGROUND VERIFIER FOUND CORRUPTED STACK [%p] (CONDITION %d)\n", stk, condition);
+
+    // copy without data can not be dumped, its header is printed
+    if (has_data)
+        LogDump(StackDump, &snapshot->stk, __func__, __FILE__, __LINE__);
+    else
+        PrintLog("STACK HEADER IS CORRUPTED\n"
+                 "SIZE:     %zu\n"
+                 "CAPACITY: %zu\n"
+                 "DATA:     [%p]\n",
+                 snapshot->stk.size, snapshot->stk.capacity, snapshot->stk.data);
+
+    if (VERIFIER.callback != nullptr)
+        VERIFIER.callback(stk, condition, VERIFIER.ctx);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void MarkReported(const Stack_t* stk, size_t index)
+{
+    assert(stk);
+
+    std::lock_guard<std::mutex> guard(REGISTRY.lock);
+
+    // stack could be moved or removed, while it was checked
+    if (index < REGISTRY.size && REGISTRY.entries[index].stk == stk)
+        REGISTRY.entries[index].reported = true;
+}
@@ -0,0 +1,105 @@
+#ifndef __STACK_VERIFIER_H_
+#define __STACK_VERIFIER_H_
+
+#include <stdio.h>
+
+#include "types.h"
+
+/*! \file
+* \brief Contains stack registry and background verifier
+*
+* StackCtor (and StackRebase) adds stack to global registry, if verifier runs or stack has verify_background set,
+* StackDtor removes it (stack keeps its registry slot, so both are O(1)). Background verifier walks
+* registered stacks by schedule: every stack is copied between two reads of its write sequence (it is odd, while
+* stack function changes stack), and copy gets full check (canaries, poison and data hash). So stacks can be used with
+* inline checks off or sampled, and corruption is still found in about one verifier period.
+* Stack, that is found corrupted, is reported once: by LogDump of its copy and by callback.
+*/
+
+/// default period of background verification in milliseconds
+static const unsigned VERIFIER_PERIOD_MS = 100;
+
+/// @brief function, that gets stack, that was found corrupted by verifier (it is called from verifier thread,
+/// stack is not locked, so it must not be read by callback, if it can be destroyed concurrently)
+typedef void (*corruption_f)(const Stack_t* stk, int condition, void* ctx);
+
+/// @brief background verifier counters
+struct VerifierStats
+{
+    /// passes over registry
+    size_t passes;
+    /// stacks, that were checked
+    size_t checked;
+    /// stacks, that were skipped, because they were being changed
+    size_t busy;
+    /// stacks, that were found corrupted
+    size_t corrupted;
+};
+
+/************************************************************//**
+ * @brief Adds stack to registry (nothing is done, if stack is registered)
+ *
+ * @param[in] stk stack pointer
+ * @return int error code
+ ************************************************************/
+int StackRegistryAdd(Stack_t* stk);
+
+/************************************************************//**
+ * @brief Removes stack from registry (nothing is done, if stack is not registered)
+ *
+ * @param[in] stk stack pointer
+ ************************************************************/
+void StackRegistryRemove(Stack_t* stk);
+
+/************************************************************//**
+ * @brief Counts registered stacks
+ *
+ * @return size_t amount of registered stacks
+ ************************************************************/
+size_t StackRegistrySize();
+
+/************************************************************//**
+ * @brief Starts background verifier thread, also stops it when program shuts down
+ *
+ * @param[in] period_ms period of verification passes in milliseconds
+ * @param[in] callback function, that gets corrupted stacks (nullptr if it is not needed)
+ * @param[in] ctx callback context
+ * @return int error code
+ ************************************************************/
+int StartVerifier(unsigned period_ms = VERIFIER_PERIOD_MS, corruption_f callback = nullptr, void* ctx = nullptr);
+
+/************************************************************//**
+ * @brief Stops background verifier thread (it finishes current pass)
+ ************************************************************/
+void StopVerifier();
+
+/************************************************************//**
+ * @brief Tells, if background verifier runs
+ *
+ * @return bool verifier runs
+ ************************************************************/
+bool VerifierRunning();
+
+/************************************************************//**
+ * @brief Gives background verifier counters
+ *
+ * @return VerifierStats counters
+ ************************************************************/
+VerifierStats GetVerifierStats();
+
+/************************************************************//**
+ * @brief Blocks verifier from copying stacks, while stack buffer is reallocated
+ * (stack must be in write section, lock is taken only while verifier runs)
+ *
+ * @return bool lock is taken
+ ************************************************************/
+bool VerifierHold();
+
+/************************************************************//**
+ * @brief Unblocks verifier after VerifierHold
+ *
+ * @param[in] held result of VerifierHold
+ ************************************************************/
+void VerifierRelease(bool held);
+
+#endif
@@ -0,0 +1,489 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "stack.h"
+#include "stack_dump.h"
+
+/*! \file
+* \brief stackdump-decode: renders binary stack dumps (see OpenDumpFile) as StackDump text or as JSON lines
+*
+* Usage: stackdump-decode [--json] FILE.stkdump
+*/
+
+/// @brief output format
+enum DecodeFormat
+{
+    /// text of StackDump
+    DECODE_TEXT,
+    /// one JSON object per record
+    DECODE_JSON
+};
+
+/// @brief decoded record
+struct DumpRecord
+{
+    /// record header
+    StackDumpHeader header;
+    /// function name (null-terminated)
+    char* func;
+    /// file name (null-terminated)
+    char* file;
+    /// stack buffer
+    elem_t* data;
+};
+
+/// @brief name of stack condition
+struct ConditionName
+{
+    /// condition bit
+    int condition;
+    /// condition name
+    const char* name;
+};
+
+// ============= STATIC FUNCS ===============
+static int ReadRecord(FILE* fp, DumpRecord* record);
+static void FreeRecord(DumpRecord* record);
+static char* ReadString(FILE* fp, const uint32_t length);
+static uint64_t CountBytesLeft(FILE* fp);
+
+static void PrintText(const DumpRecord* record);
+static void PrintTextConditions(const DumpRecord* record);
+static void PrintJson(const DumpRecord* record);
+static void PrintJsonString(const char* str);
+static void PrintJsonElements(const DumpRecord* record, const uint64_t first, const uint64_t last);
+static void PrintAddress(const uint64_t address);
+//============================================
+
+// =============CONSTS============
+static const elem_t POISON = STACK_POISON;
+
+/// longest function or file name in record
+static const uint32_t MAX_DUMP_STRING_LEN = 1 << 16;
+/// largest amount of elements in record
+static const uint64_t MAX_DUMP_DATA_COUNT = (uint64_t) 1 << 36;
+
+static const ConditionName CONDITION_NAMES[] =
+{
+    {INVALID_CAPACITY,     "INVALID_CAPACITY"},
+    {EMPTY_STACK,          "EMPTY_STACK"},
+    {INVALID_SIZE,         "INVALID_SIZE"},
+    {INVALID_DATA,         "INVALID_DATA"},
+    {POISON_ACCESS,        "POISON_ACCESS"},
+    {DATA_CANARY_TRIGGER,  "DATA_CANARY_TRIGGER"},
+    {STACK_CANARY_TRIGGER, "STACK_CANARY_TRIGGER"},
+    {INVALID_HASH_FUNC,    "INVALID_HASH_FUNC"},
+    {INCORRECT_DATA_HASH,  "INCORRECT_DATA_HASH"},
+    {INCORRECT_STACK_HASH, "INCORRECT_STACK_HASH"}
+};
+// ===============================
+
+int main(const int argc, const char* argv[])
+{
+    DecodeFormat format    = DECODE_TEXT;
+    const char*  file_name = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0)
+            format = DECODE_JSON;
+        else
+            file_name = argv[i];
+    }
+
+    if (file_name == nullptr)
+    {
+        fprintf(stderr, "usage: %s [--json] FILE.stkdump\n", argv[0]);
+        return (int) ERRORS::OPEN_FILE;
+    }
+
+    FILE* fp = fopen(file_name, "rb");
+
+    if (fp == nullptr)
+    {
+        fprintf(stderr, "can not open %s\n", file_name);
+        return (int) ERRORS::OPEN_FILE;
+    }
+
+    DumpRecord record = {};
+    int error         = (int) ERRORS::NONE;
+
+    while ((error = ReadRecord(fp, &record)) == (int) ERRORS::NONE)
+    {
+        if (format == DECODE_JSON)
+            PrintJson(&record);
+        else
+            PrintText(&record);
+
+        FreeRecord(&record);
+    }
+
+    fclose(fp);
+
+    // READ_FILE means, that file ended between records
+    return (error == (int) ERRORS::READ_FILE) ? (int) ERRORS::NONE : error;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static int ReadRecord(FILE* fp, DumpRecord* record)
+{
+    assert(fp);
+    assert(record);
+
+    *record = {};
+
+    size_t read = fread(&record->header, 1, sizeof(StackDumpHeader), fp);
+
+    if (read == 0)
+        return (int) ERRORS::READ_FILE;
+
+    if (read != sizeof(StackDumpHeader))
+    {
+        fprintf(stderr, "record is cut off\n");
+        return (int) ERRORS::INVALID_STACK;
+    }
+
+    const StackDumpHeader* header = &record->header;
+
+    if (memcmp(header->magic, STACK_DUMP_MAGIC, sizeof(STACK_DUMP_MAGIC)) != 0 ||
+        header->version != STACK_DUMP_VERSION)
+    {
+        fprintf(stderr, "not a stack dump record (or unknown version)\n");
+        return (int) ERRORS::INVALID_STACK;
+    }
+
+    if (header->elem_size != sizeof(elem_t))
+    {
+        fprintf(stderr, "element size %" PRIu32 " is not supported (decoder has %zu)\n",
+                header->elem_size, sizeof(elem_t));
+        return (int) ERRORS::INVALID_STACK;
+    }
+
+    // lengths come from file, so record, that does not fit in rest of file, is not allocated
+    uint64_t left = CountBytesLeft(fp);
+
+    if (header->func_len > MAX_DUMP_STRING_LEN || header->file_len > MAX_DUMP_STRING_LEN ||
+        header->data_count > MAX_DUMP_DATA_COUNT ||
+        (uint64_t) header->func_len + header->file_len + header->data_count * sizeof(elem_t) > left)
+    {
+        fprintf(stderr, "record is cut off or its lengths are invalid\n");
+        return (int) ERRORS::INVALID_STACK;
+    }
+
+    record->func = ReadString(fp, header->func_len);
+    record->file = ReadString(fp, header->file_len);
+    record->data = (elem_t*) calloc(header->data_count + 1, sizeof(elem_t));
+
+    if (record->func == nullptr || record->file == nullptr || record->data == nullptr)
+    {
+        FreeRecord(record);
+        return (int) ERRORS::ALLOCATE_MEMORY;
+    }
+
+    if (fread(record->data, sizeof(elem_t), header->data_count, fp) != header->data_count)
+    {
+        FreeRecord(record);
+        fprintf(stderr, "record is cut off\n");
+        return (int) ERRORS::INVALID_STACK;
+    }
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static char* ReadString(FILE* fp, const uint32_t length)
+{
+    assert(fp);
+
+    char* str = (char*) calloc((size_t) length + 1, 1);
+
+    if (str != nullptr && fread(str, 1, length, fp) != length)
+    {
+        free(str);
+        return nullptr;
+    }
+
+    return str;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static uint64_t CountBytesLeft(FILE* fp)
+{
+    assert(fp);
+
+    struct stat file_stat = {};
+    long offset           = ftell(fp);
+
+    if (fstat(fileno(fp), &file_stat) != 0 || offset < 0 || (uint64_t) file_stat.st_size < (uint64_t) offset)
+        return 0;
+
+    return (uint64_t) file_stat.st_size - (uint64_t) offset;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void FreeRecord(DumpRecord* record)
+{
+    assert(record);
+
+    free(record->func);
+    free(record->file);
+    free(record->data);
+
+    *record = {};
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void PrintText(const DumpRecord* record)
+{
+    assert(record);
+
+    const StackDumpHeader* header = &record->header;
+
+    printf("--------------------LOG CALLED--------------------\n"
+           "RUNNING FUNCTION %s FROM FILE \"%s\"(%" PRId32 ")\n",
+           record->func, record->file, header->line);
+
+    printf("Stack                > [");
+    PrintAddress(header->stack_addr);
+    printf("]\n"
+           "size                 > %" PRIu64 "\n"
+           "capacity             > %" PRIu64 "\n"
+           "data place           > [",
+           header->size, header->capacity);
+    PrintAddress(header->data_addr);
+    printf("]\n"
+           "verify level         > %" PRId32 "\n"
+           "checks run/skipped   > %" PRIu64 "/%" PRIu64 "\n"
+           "reallocs             > %" PRIu64 " (%" PRIu64 " bytes copied)\n",
+           header->verify_level, header->checks_run, header->checks_skipped,
+           header->reallocs, header->bytes_copied);
+
+    if ((header->flags & DUMP_CANARY) != 0)
+        printf("STACK PREFIX CANARY  > %" PRIX64 "\n"
+               "STACK POSTFIX CANARY > %" PRIX64 "\n",
+               header->stack_prefix, header->stack_postfix);
+
+    if ((header->flags & DUMP_HASH) != 0)
+    {
+        printf("HASH FUNCTION        > [");
+        PrintAddress(header->hash_func_addr);
+        printf("]\n"
+               "::::::EXPECTED HASH::::::\n"
+               "STACK HASH           > %" PRIu32 "\n"
+               "DATA HASH            > %" PRIu32 "\n"
+               "::::::CURRENT HASH::::::\n"
+               "STACK CURRENT        > %" PRIu32 "\n"
+               "DATA CURRENT         > %" PRIu32 "\n",
+               header->stack_hash, header->data_hash, header->stack_current, header->data_current);
+    }
+
+    printf("ELEMENTS: \n\n");
+
+    uint64_t size = (header->size < header->data_count) ? header->size : header->data_count;
+
+    for (uint64_t i = 0; i < size; i++)
+        printf("*[%" PRIu64 "] > " PRINT_ELEM_T "\n", i, record->data[i]);
+
+    printf("clear elements\n");
+
+    for (uint64_t i = size; i < header->data_count; i++)
+        printf("*[%" PRIu64 "] > " PRINT_ELEM_T "%s\n", i, record->data[i],
+               (record->data[i] == POISON) ? " (POISONED)" : "");
+
+    if ((header->flags & DUMP_CANARY) != 0)
+        printf("PREFIX DATA CANARY  > %" PRIX64 "\n"
+               "POSTFIX DATA CANARY > %" PRIX64 "\n",
+               header->data_prefix, header->data_postfix);
+
+    if (header->status != OK)
+        PrintTextConditions(record);
+
+    char time_str[32] = "";
+    time_t dump_time  = (time_t) header->time;
+
+    strftime(time_str, sizeof(time_str), "%H:%M:%S", localtime(&dump_time));
+
+    printf("END TIME: %s\n"
+           "--------------------------------------------------\n", time_str);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void PrintTextConditions(const DumpRecord* record)
+{
+    assert(record);
+
+    const StackDumpHeader* header = &record->header;
+
+    printf("\n>>>>>>>>>>STACK CONDITIONS<<<<<<<<<\n");
+
+    if ((header->status & INVALID_CAPACITY) != 0)
+        printf("INVALID STACK CAPACITY\n"
+               "SIZE:     %" PRIu64 "\n"
+               "CAPACITY: %" PRIu64 "\n",
+               header->size, header->capacity);
+
+    if ((header->status & INVALID_SIZE) != 0)
+        printf("INVALID STACK SIZE\n"
+               "SIZE:     %" PRIu64 "\n",
+               header->size);
+
+    if ((header->status & INVALID_DATA) != 0)
+    {
+        printf("INVALID STACK DATA\n"
+               "DATA:     [");
+        PrintAddress(header->data_addr);
+        printf("]\n");
+    }
+
+    if ((header->status & EMPTY_STACK) != 0)
+        printf("CAN NOT POP ELEMENT FROM EMPTY STACK\n");
+
+    if ((header->status & POISON_ACCESS) != 0)
+        printf("CAN NOT ACCESS TO POISONED ELEMENT\n");
+
+    if ((header->status & DATA_CANARY_TRIGGER) != 0 && (header->flags & DUMP_CANARY) == 0)
+        printf("DATA GUARD PAGE TRIGGERED\n");
+    else if ((header->status & DATA_CANARY_TRIGGER) != 0)
+        printf("DATA CANARY TRIGGERED\n"
+               "LEFT CANARY:     %" PRIu64 "\n"
+               "RIGHT CANARY:    %" PRIu64 "\n",
+               header->data_prefix, header->data_postfix);
+
+    if ((header->status & STACK_CANARY_TRIGGER) != 0)
+        printf("STACK CANARY TRIGGERED\n"
+               "LEFT CANARY:     %" PRIu64 "\n"
+               "RIGHT CANARY:    %" PRIu64 "\n",
+               header->stack_prefix, header->stack_postfix);
+
+    if ((header->status & INVALID_HASH_FUNC) != 0)
+    {
+        printf("INVALID HASH FUNCTION\n"
+               "FUNC:     [");
+        PrintAddress(header->hash_func_addr);
+        printf("]\n");
+    }
+
+    if ((header->status & INCORRECT_DATA_HASH) != 0)
+        printf("INCORRECT DATA HASH\n"
+               "EXPECTED:     %" PRIu32 "\n"
+               "CURRENT:      %" PRIu32 "\n",
+               header->data_hash, header->data_current);
+
+    if ((header->status & INCORRECT_STACK_HASH) != 0)
+        printf("INCORRECT STACK HASH\n"
+               "EXPECTED:     %" PRIu32 "\n"
+               "CURRENT:      %" PRIu32 "\n",
+               header->stack_hash, header->stack_current);
+
+    printf(">>>>>>>>STACK CONDITIONS END<<<<<<<\n\n");
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void PrintJson(const DumpRecord* record)
+{
+    assert(record);
+
+    const StackDumpHeader* header = &record->header;
+
+    printf("{\"func\": ");
+    PrintJsonString(record->func);
+    printf(", \"file\": ");
+    PrintJsonString(record->file);
+    printf(", \"line\": %" PRId32 ", \"time\": %" PRId64 ", \"stack\": \"0x%" PRIx64 "\", "
+           "\"data_place\": \"0x%" PRIx64 "\", \"size\": %" PRIu64 ", \"capacity\": %" PRIu64 ", "
+           "\"verify_level\": %" PRId32 ", \"checks_run\": %" PRIu64 ", \"checks_skipped\": %" PRIu64 ", "
+           "\"reallocs\": %" PRIu64 ", \"bytes_copied\": %" PRIu64 ", \"status\": %" PRId32 ", \"conditions\": [",
+           header->line, header->time, header->stack_addr, header->data_addr, header->size, header->capacity,
+           header->verify_level, header->checks_run, header->checks_skipped, header->reallocs,
+           header->bytes_copied, header->status);
+
+    bool first = true;
+    for (size_t i = 0; i < sizeof(CONDITION_NAMES) / sizeof(CONDITION_NAMES[0]); i++)
+    {
+        if ((header->status & CONDITION_NAMES[i].condition) == 0)
+            continue;
+
+        printf("%s\"%s\"", first ? "" : ", ", CONDITION_NAMES[i].name);
+        first = false;
+    }
+
+    printf("]");
+
+    if ((header->flags & DUMP_CANARY) != 0)
+        printf(", \"canary\": {\"stack_prefix\": %" PRIu64 ", \"stack_postfix\": %" PRIu64 ", "
+               "\"data_prefix\": %" PRIu64 ", \"data_postfix\": %" PRIu64 "}",
+               header->stack_prefix, header->stack_postfix, header->data_prefix, header->data_postfix);
+
+    if ((header->flags & DUMP_HASH) != 0)
+        printf(", \"hash\": {\"func\": \"0x%" PRIx64 "\", \"stack_expected\": %" PRIu32 ", "
+               "\"stack_current\": %" PRIu32 ", \"data_expected\": %" PRIu32 ", \"data_current\": %" PRIu32 "}",
+               header->hash_func_addr, header->stack_hash, header->stack_current,
+               header->data_hash, header->data_current);
+
+    uint64_t size = (header->size < header->data_count) ? header->size : header->data_count;
+
+    printf(", \"elements\": ");
+    PrintJsonElements(record, 0, size);
+    printf(", \"clear_elements\": ");
+    PrintJsonElements(record, size, header->data_count);
+    printf("}\n");
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void PrintJsonElements(const DumpRecord* record, const uint64_t first, const uint64_t last)
+{
+    assert(record);
+
+    putchar('[');
+
+    for (uint64_t i = first; i < last; i++)
+        printf((i == first) ? PRINT_ELEM_T : ", " PRINT_ELEM_T, record->data[i]);
+
+    putchar(']');
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void PrintJsonString(const char* str)
+{
+    assert(str);
+
+    putchar('"');
+
+    for (; *str != '\0'; str++)
+    {
+        unsigned char symbol = (unsigned char) *str;
+
+        if (symbol == '"' || symbol == '\\')
+            printf("\\%c", symbol);
+        else if (symbol < 0x20)
+            printf("\\u%04x", symbol);
+        else
+            putchar(symbol);
+    }
+
+    putchar('"');
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void PrintAddress(const uint64_t address)
+{
+    // the same as %p of glibc
+    if (address == 0)
+        printf("(nil)");
+    else
+        printf("0x%" PRIx64, address);
+}
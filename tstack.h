@@ -0,0 +1,675 @@
+#ifndef __TSTACK_H_
+#define __TSTACK_H_
+
+/*! \file
+* \brief Contains policy-based stack template
+*
+* Element type, protection, hash function and allocator are template parameters,
+* so protections, that are off, compile to nothing and hash function and allocator calls are inlined.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <type_traits>
+
+#include "stack.h"
+#include "allocator.h"
+#include "hash.h"
+#include "poison.h"
+#include "errors.h"
+#include "log_funcs.h"
+
+// ============= PROTECTION POLICIES ===============
+
+/// @brief no canaries, no poison
+struct NoProtection
+{
+    /// canaries around stack and data
+    static constexpr bool CANARY = false;
+    /// poison in empty slots
+    static constexpr bool POISON = false;
+};
+
+/// @brief poison in empty slots
+struct PoisonProtection
+{
+    /// canaries around stack and data
+    static constexpr bool CANARY = false;
+    /// poison in empty slots
+    static constexpr bool POISON = true;
+};
+
+/// @brief canaries around stack and data, poison in empty slots
+struct CanaryProtection
+{
+    /// canaries around stack and data
+    static constexpr bool CANARY = true;
+    /// poison in empty slots
+    static constexpr bool POISON = true;
+};
+
+// ============= HASH POLICIES ===============
+
+/// @brief no hash protection
+struct NoHash
+{
+    /// hash protection
+    static constexpr bool ENABLED = false;
+
+    /// hash function
+    static hash_t Hash(const void*, size_t) { return 0; }
+};
+
+/// @brief hash protection with MurmurHash
+struct MurmurHashPolicy
+{
+    /// hash protection
+    static constexpr bool ENABLED = true;
+
+    /// hash function
+    static hash_t Hash(const void* obj, size_t size) { return MurmurHashInline(obj, size); }
+};
+
+// ============= ALLOCATOR POLICIES ===============
+
+/// @brief allocator, that uses malloc, realloc and free (takes no place in stack)
+struct MallocAllocator
+{
+    /// allocates size bytes
+    void* Allocate(size_t size)                                      { return malloc(size); }
+    /// reallocates block of old_size bytes to new_size bytes
+    void* Reallocate(void* ptr, size_t /*old_size*/, size_t new_size) { return realloc(ptr, new_size); }
+    /// frees block of size bytes
+    void  Free(void* ptr, size_t /*size*/)                           { free(ptr); }
+};
+
+/// @brief allocator, that wraps StackAllocator of C stack (StackPool, StackVirtualMemory...)
+struct StackAllocatorPolicy
+{
+    /// wrapped allocator
+    const StackAllocator* allocator = &MALLOC_ALLOCATOR;
+
+    /// allocates size bytes
+    void* Allocate(size_t size) { return allocator->alloc(allocator->ctx, size); }
+    /// reallocates block of old_size bytes to new_size bytes
+    void* Reallocate(void* ptr, size_t old_size, size_t new_size)
+    {
+        return allocator->realloc(allocator->ctx, ptr, old_size, new_size);
+    }
+    /// frees block of size bytes
+    void  Free(void* ptr, size_t size) { allocator->free(allocator->ctx, ptr, size); }
+};
+
+// ============= FIELDS ===============
+
+/// template stack canary value
+static const canary_t      TSTACK_CANARY      = STACK_CANARY;
+/// byte, that fills empty slots of template stack
+static const unsigned char TSTACK_POISON_BYTE = 0xBE;
+
+/// @brief canary, that takes no place, when canaries are off
+template <bool ENABLED, int TAG>
+struct TStackCanary
+{
+    /// canary value
+    canary_t value;
+};
+
+/// @brief canary, that takes no place, when canaries are off
+template <int TAG>
+struct TStackCanary<false, TAG> {};
+
+/// @brief hashes, that take no place, when hash protection is off
+template <bool ENABLED>
+struct TStackHash
+{
+    /// xor of (index, element) hashes of all elements
+    hash_t data_hash;
+    /// stack hash
+    hash_t stack_hash;
+
+    /// first element, that is not scrubbed yet (data hash is verified by HASH_SCRUB_STEP elements per check)
+    size_t scrub_pos;
+    /// xor of (index, element) hashes of scrubbed elements
+    hash_t scrub_acc;
+};
+
+/// @brief hashes, that take no place, when hash protection is off
+template <>
+struct TStackHash<false> {};
+
+#ifdef TSTACK_CHECK
+#undef TSTACK_CHECK
+
+#endif
+#define TSTACK_CHECK()      do                                                          \
+                            {                                                           \
+                                if (!IsValid(__func__, __FILE__, __LINE__))             \
+                                    return (int) ERRORS::INVALID_STACK;                 \
+                            } while(0)
+
+/// @brief Stack template
+template <typename T,
+          typename Protection = CanaryProtection,
+          typename Hash       = MurmurHashPolicy,
+          typename Alloc      = MallocAllocator>
+class TStack
+{
+    static_assert(std::is_trivially_copyable<T>::value, "stack elements are moved by realloc");
+    static_assert(!Hash::ENABLED || std::has_unique_object_representations<T>::value ||
+                  std::is_floating_point<T>::value, "hashed elements must not contain padding");
+    static_assert(!Hash::ENABLED || std::is_empty<Alloc>::value ||
+                  std::has_unique_object_representations<Alloc>::value, "hashed allocator must not contain padding");
+
+    static constexpr bool CANARY  = Protection::CANARY;
+    static constexpr bool POISON  = Protection::POISON;
+    static constexpr bool HASH    = Hash::ENABLED;
+    static constexpr bool CHECKED = CANARY || POISON || HASH;
+
+    static constexpr size_t DATA_OFFSET = (!CANARY)                       ? 0 :
+                                          (alignof(T) > sizeof(canary_t)) ? alignof(T) : sizeof(canary_t);
+
+  public:
+    TStack() :
+        stack_prefix_(),
+        alloc_(),
+        data_(nullptr),
+        size_(0),
+        capacity_(0),
+        status_(OK),
+        hash_(),
+        stack_postfix_()
+    {}
+
+    TStack(const TStack&)            = delete;
+    TStack& operator=(const TStack&) = delete;
+
+    ~TStack()
+    {
+        if (data_ != nullptr)
+            Dtor();
+    }
+
+    /************************************************************//**
+     * @brief Creates stack
+     *
+     * @param[in] capacity stack capacity
+     * @param[in] alloc buffer allocator
+     * @return int error code
+     *************************************************************/
+    int Ctor(size_t capacity = MIN_CAPACITY, const Alloc& alloc = Alloc())
+    {
+        assert(data_ == nullptr);
+
+        if (capacity == 0)
+            capacity = MIN_CAPACITY;
+
+        alloc_ = alloc;
+
+        char* buffer = (char*) alloc_.Allocate(BufferSize(capacity));
+
+        if (buffer == nullptr)
+            return (int) ERRORS::ALLOCATE_MEMORY;
+
+        data_     = (T*)(void*)(buffer + DATA_OFFSET);
+        size_     = 0;
+        capacity_ = capacity;
+        status_   = OK;
+
+        if constexpr (CANARY)
+        {
+            stack_prefix_.value  = TSTACK_CANARY;
+            stack_postfix_.value = TSTACK_CANARY;
+            WriteDataCanaries();
+        }
+
+        PoisonSlots(0, capacity_);
+
+        if constexpr (HASH)
+        {
+            hash_.data_hash = 0;
+            hash_.scrub_pos = 0;
+            hash_.scrub_acc = 0;
+            ReInitStackHash();
+        }
+
+        TSTACK_CHECK();
+
+        return (int) ERRORS::NONE;
+    }
+
+    /************************************************************//**
+     * @brief Destroys stack (buffer is freed, even if stack is corrupted)
+     *
+     * @return int error code
+     ************************************************************/
+    int Dtor()
+    {
+        bool valid = IsValid(__func__, __FILE__, __LINE__);
+
+        if (data_ != nullptr)
+            alloc_.Free((char*) data_ - DATA_OFFSET, BufferSize(capacity_));
+
+        data_     = nullptr;
+        size_     = 0;
+        capacity_ = 0;
+        status_   = OK;
+
+        return (valid) ? (int) ERRORS::NONE : (int) ERRORS::INVALID_STACK;
+    }
+
+    /************************************************************//**
+     * @brief Pushes element in stack
+     *
+     * @param[in] value element
+     * @return int error code
+     ************************************************************/
+    int Push(const T& value)
+    {
+        assert(data_);
+
+        TSTACK_CHECK();
+
+        if (size_ == capacity_)
+        {
+            int realloc_error = Realloc(capacity_ * 2);
+            if (realloc_error != (int) ERRORS::NONE)
+                return realloc_error;
+        }
+
+        if constexpr (HASH)
+            hash_.data_hash ^= SlotHash(size_, value);
+
+        data_[size_++] = value;
+
+        if constexpr (HASH)
+            ReInitStackHash();
+
+        TSTACK_CHECK();
+
+        return (int) ERRORS::NONE;
+    }
+
+    /************************************************************//**
+     * @brief Pops element from stack
+     *
+     * @param[out] ret_value popped element
+     * @return int error code
+     ************************************************************/
+    int Pop(T* ret_value)
+    {
+        assert(data_);
+        assert(ret_value);
+
+        if (size_ == 0)
+        {
+            status_ |= EMPTY_STACK;
+            LogDump(Dump, this, __func__, __FILE__, __LINE__);
+            return (int) ERRORS::INVALID_STACK;
+        }
+
+        TSTACK_CHECK();
+
+        *ret_value = data_[--size_];
+
+        if constexpr (HASH)
+        {
+            hash_t slot_hash = SlotHash(size_, *ret_value);
+
+            hash_.data_hash ^= slot_hash;
+
+            // popped element leaves scrubbed part
+            if (size_ < hash_.scrub_pos)
+            {
+                hash_.scrub_acc ^= slot_hash;
+                hash_.scrub_pos  = size_;
+            }
+        }
+
+        PoisonSlots(size_, size_ + 1);
+
+        if (capacity_ > MIN_CAPACITY && (double) size_ <= (double) capacity_ * DEFAULT_SHRINK_THRESHOLD)
+        {
+            int realloc_error = Realloc((size_t) ((double) capacity_ / DEFAULT_GROW_FACTOR));
+            if (realloc_error != (int) ERRORS::NONE)
+                return realloc_error;
+        }
+
+        if constexpr (HASH)
+            ReInitStackHash();
+
+        TSTACK_CHECK();
+
+        return (int) ERRORS::NONE;
+    }
+
+    /// @return size_t stack size
+    size_t Size() const     { return size_; }
+    /// @return size_t stack capacity
+    size_t Capacity() const { return capacity_; }
+    /// @return int stack status
+    int Status() const      { return status_; }
+
+    /************************************************************//**
+     * @brief Verifies stack (whole empty tail and data hash are checked)
+     *
+     * @return int stack condition code
+     ************************************************************/
+    int Ok()
+    {
+        Check();
+
+        if constexpr (HASH)
+        {
+            if (hash_.data_hash != DataHash())
+                status_ |= INCORRECT_DATA_HASH;
+        }
+
+        if constexpr (POISON)
+        {
+            if (!IsPoisoned(size_, capacity_))
+                status_ |= POISON_ACCESS;
+        }
+
+        return status_;
+    }
+
+    /************************************************************//**
+     * @brief Prints info about stack in output stream (dump_f for LogDump)
+     *
+     * @param[in] fp output stream
+     * @param[in] stack stack pointer
+     * @param[in] func function, where print called
+     * @param[in] file file, where print called
+     * @param[in] line line, where print caled
+     * @return int error code
+     ************************************************************/
+    static int Dump(FILE* fp, const void* stack, const char* func, const char* file, const int line)
+    {
+        assert(stack);
+        assert(func);
+        assert(file);
+
+        const TStack* stk = (const TStack*) stack;
+
+        LOG_START_MOD(func, file, line);
+
+        fprintf(fp, "TStack               > [%p]\n"
+                    "element size         > %zu\n"
+                    "size                 > %zu\n"
+                    "capacity             > %zu\n"
+                    "data place           > [%p]\n"
+                    "status               > %d\n",
+                    stk, sizeof(T), stk->size_, stk->capacity_, stk->data_, stk->status_);
+
+        if constexpr (CANARY)
+            fprintf(fp, "STACK PREFIX CANARY  > %llX\n"
+                        "STACK POSTFIX CANARY > %llX\n"
+                        "PREFIX DATA CANARY   > %llX\n"
+                        "POSTFIX DATA CANARY  > %llX\n",
+                        stk->stack_prefix_.value, stk->stack_postfix_.value,
+                        stk->ReadDataCanary(false), stk->ReadDataCanary(true));
+
+        if constexpr (HASH)
+            fprintf(fp, "STACK HASH           > %u (current %u)\n"
+                        "DATA HASH            > %u (current %u)\n",
+                        stk->hash_.stack_hash, stk->StackHash(),
+                        stk->hash_.data_hash,  stk->DataHash());
+
+        fprintf(fp, "ELEMENTS: \n\n");
+
+        for (size_t i = 0; i < stk->size_; i++)
+        {
+            if constexpr (std::is_integral<T>::value)
+                fprintf(fp, "*[%zu] > %lld\n", i, (long long) stk->data_[i]);
+            else if constexpr (std::is_floating_point<T>::value)
+                fprintf(fp, "*[%zu] > %lg\n",  i, (double) stk->data_[i]);
+            else
+                fprintf(fp, "*[%zu] > [%p]\n", i, (const void*) &stk->data_[i]);
+        }
+
+        LOG_END();
+
+        return (int) ERRORS::NONE;
+    }
+
+  private:
+    /// stack prefix canary (no place, if canaries are off)
+    [[no_unique_address]] TStackCanary<CANARY, 0> stack_prefix_;
+
+    /// buffer allocator (no place, if it has no state)
+    [[no_unique_address]] Alloc alloc_;
+    /// stack data
+    T* data_;
+    /// stack size
+    size_t size_;
+    /// stack capacity
+    size_t capacity_;
+    /// stack status (0 if everything is fine)
+    int status_;
+
+    /// hashes (no place, if hash protection is off)
+    [[no_unique_address]] TStackHash<HASH> hash_;
+
+    /// stack postfix canary (no place, if canaries are off)
+    [[no_unique_address]] TStackCanary<CANARY, 1> stack_postfix_;
+
+    static size_t BufferSize(size_t capacity)
+    {
+        return DATA_OFFSET + capacity * sizeof(T) + (CANARY ? sizeof(canary_t) : 0);
+    }
+
+    int Realloc(size_t new_capacity)
+    {
+        if (new_capacity < MIN_CAPACITY)
+            new_capacity = MIN_CAPACITY;
+
+        if (new_capacity < size_)
+            new_capacity = size_;
+
+        size_t old_capacity = capacity_;
+
+        char* buffer = (char*) alloc_.Reallocate((char*) data_ - DATA_OFFSET,
+                                                 BufferSize(old_capacity), BufferSize(new_capacity));
+
+        if (buffer == nullptr)
+            return (int) ERRORS::ALLOCATE_MEMORY;
+
+        data_     = (T*)(void*)(buffer + DATA_OFFSET);
+        capacity_ = new_capacity;
+
+        if constexpr (CANARY)
+            WriteDataCanaries();
+
+        if (new_capacity > old_capacity)
+            PoisonSlots(old_capacity, new_capacity);
+
+        return (int) ERRORS::NONE;
+    }
+
+    bool IsValid(const char* func, const char* file, const int line)
+    {
+        if constexpr (!CHECKED)
+            return true;
+
+        if (Check() == OK)
+            return true;
+
+        LogDump(Dump, this, func, file, line);
+        return false;
+    }
+
+    // check is O(1): data hash is verified by HASH_SCRUB_STEP elements per check, as C stack does it,
+    // Ok recounts it at once
+    int Check()
+    {
+        if constexpr (CANARY)
+        {
+            if (stack_prefix_.value != TSTACK_CANARY || stack_postfix_.value != TSTACK_CANARY)
+                status_ |= STACK_CANARY_TRIGGER;
+
+            if (ReadDataCanary(false) != TSTACK_CANARY || ReadDataCanary(true) != TSTACK_CANARY)
+                status_ |= DATA_CANARY_TRIGGER;
+        }
+
+        if (size_ > capacity_)
+            status_ |= INVALID_SIZE;
+
+        if (data_ == nullptr)
+            status_ |= INVALID_DATA;
+
+        if constexpr (POISON)
+        {
+            if (size_ < capacity_ && !IsPoisoned(size_, size_ + 1))
+                status_ |= POISON_ACCESS;
+        }
+
+        if constexpr (HASH)
+        {
+            if (hash_.stack_hash != StackHash())
+                status_ |= INCORRECT_STACK_HASH;
+
+            if (!ScrubDataHash())
+                status_ |= INCORRECT_DATA_HASH;
+        }
+
+        return status_;
+    }
+
+    bool ScrubDataHash()
+    {
+        size_t end = hash_.scrub_pos + HASH_SCRUB_STEP;
+        if (end > size_)
+            end = size_;
+
+        for (size_t i = hash_.scrub_pos; i < end; i++)
+            hash_.scrub_acc ^= SlotHash(i, data_[i]);
+
+        hash_.scrub_pos = end;
+
+        if (end < size_)
+            return true;
+
+        hash_t scrubbed_hash = hash_.scrub_acc;
+
+        hash_.scrub_pos = 0;
+        hash_.scrub_acc = 0;
+
+        return scrubbed_hash == hash_.data_hash;
+    }
+
+    void WriteDataCanaries()
+    {
+        const canary_t canary = TSTACK_CANARY;
+
+        memcpy((char*) data_ - sizeof(canary_t), &canary, sizeof(canary_t));
+        memcpy(data_ + capacity_,                &canary, sizeof(canary_t));
+    }
+
+    canary_t ReadDataCanary(bool postfix) const
+    {
+        canary_t canary = 0;
+
+        if (postfix)
+            memcpy(&canary, data_ + capacity_, sizeof(canary_t));
+        else
+            memcpy(&canary, (const char*) data_ - sizeof(canary_t), sizeof(canary_t));
+
+        return canary;
+    }
+
+    void PoisonSlots(size_t left, size_t right)
+    {
+        if constexpr (POISON)
+        {
+            if constexpr (sizeof(T) == sizeof(elem_t) && alignof(T) >= alignof(elem_t))
+            {
+                elem_t poison = 0;
+                memset(&poison, TSTACK_POISON_BYTE, sizeof(elem_t));
+
+                PoisonFill((elem_t*)(void*)(data_ + left), right - left, poison);
+            }
+            else
+                memset((void*)(data_ + left), TSTACK_POISON_BYTE, (right - left) * sizeof(T));
+        }
+    }
+
+    bool IsPoisoned(size_t left, size_t right) const
+    {
+        if constexpr (sizeof(T) == sizeof(elem_t) && alignof(T) >= alignof(elem_t))
+        {
+            elem_t poison = 0;
+            memset(&poison, TSTACK_POISON_BYTE, sizeof(elem_t));
+
+            return PoisonCheck((const elem_t*)(const void*)(data_ + left), right - left, poison);
+        }
+        else
+        {
+            const unsigned char* bytes = (const unsigned char*)(data_ + left);
+
+            for (size_t i = 0; i < (right - left) * sizeof(T); i++)
+            {
+                if (bytes[i] != TSTACK_POISON_BYTE)
+                    return false;
+            }
+
+            return true;
+        }
+    }
+
+    static hash_t SlotHash(size_t index, const T& value)
+    {
+        struct
+        {
+            size_t             index;
+            unsigned long long value_hash;
+        } slot = {index, Hash::Hash(&value, sizeof(T))};
+
+        return Hash::Hash(&slot, sizeof(slot));
+    }
+
+    hash_t DataHash() const
+    {
+        hash_t data_hash = 0;
+
+        for (size_t i = 0; i < size_; i++)
+            data_hash ^= SlotHash(i, data_[i]);
+
+        return data_hash;
+    }
+
+    hash_t StackHash() const
+    {
+        if constexpr (HASH)
+        {
+            struct
+            {
+                unsigned long long alloc_hash;
+                const void*        data;
+                size_t             size;
+                size_t             capacity;
+                unsigned long long data_hash;
+            } header = {0, data_, size_, capacity_, hash_.data_hash};
+
+            // allocator state (StackAllocator pointer...) is covered too
+            if constexpr (!std::is_empty<Alloc>::value)
+                header.alloc_hash = Hash::Hash(&alloc_, sizeof(Alloc));
+
+            return Hash::Hash(&header, sizeof(header));
+        }
+        else
+            return 0;
+    }
+
+    void ReInitStackHash()
+    {
+        if constexpr (HASH)
+            hash_.stack_hash = StackHash();
+    }
+};
+
+#undef TSTACK_CHECK
+
+#endif
@@ -0,0 +1,493 @@
+#include <stdlib.h>
+#include <assert.h>
+
+#include "work_deque.h"
+#include "log_funcs.h"
+
+// ============= STATIC FUNCS ===============
+static DequeBuffer* BufferCtor(const size_t capacity);
+static void BufferDtor(DequeBuffer* buffer);
+static DequeBuffer* GrowBuffer(WorkDeque* deque, DequeBuffer* buffer, const int64_t top, const int64_t bottom);
+
+static inline elem_t LoadSlot(const DequeBuffer* buffer, const int64_t index);
+static inline void StoreSlot(DequeBuffer* buffer, const int64_t index, const elem_t value);
+
+#if CANARY_PROTECT
+static canary_t* GetPrefixBufferCanary(const DequeBuffer* buffer);
+static canary_t* GetPostfixBufferCanary(const DequeBuffer* buffer);
+#endif
+static int DequeCheck(const WorkDeque* deque, const DequeBuffer* buffer);
+#if DEQUE_VALIDATE
+static void PoisonStolen(WorkDeque* deque, DequeBuffer* buffer);
+static int ReportCorruption(WorkDeque* deque, const int condition,
+                            const char* func, const char* file, const int line);
+#endif
+static void PrintDequeCondition(const WorkDeque* deque);
+//============================================
+
+#ifdef REPORT_CORRUPTION
+#undef REPORT_CORRUPTION
+
+#endif
+#define REPORT_CORRUPTION(deque, condition) ReportCorruption(deque, condition, __func__, __FILE__, __LINE__)
+
+#ifdef CHECK_DEQUE
+#undef CHECK_DEQUE
+
+#endif
+#define CHECK_DEQUE(deque, buffer)  do                                                          \
+                                    {                                                           \
+                                        int condition_ = DequeCheck(deque, buffer);             \
+                                        if (condition_ != OK)                                   \
+                                            return REPORT_CORRUPTION(deque, condition_);        \
+                                    } while (0)
+
+// =============CONSTS============
+static const canary_t canary_val = STACK_CANARY;
+static const elem_t POISON       = STACK_POISON;
+// ===============================
+
+int WorkDequeCtor(WorkDeque* deque, size_t capacity)
+{
+    assert(deque);
+
+    size_t buffer_capacity = DEQUE_MIN_CAPACITY;
+    while (buffer_capacity < capacity)
+        buffer_capacity *= 2;
+
+    DequeBuffer* buffer = BufferCtor(buffer_capacity);
+
+    if (buffer == nullptr)
+        return (int) ERRORS::ALLOCATE_MEMORY;
+
+    ON_CANARY
+    (
+        deque->deque_prefix  = canary_val;
+        deque->deque_postfix = canary_val
+    );
+
+    deque->top.store(0, std::memory_order_relaxed);
+    deque->bottom.store(0, std::memory_order_relaxed);
+    deque->buffer.store(buffer, std::memory_order_relaxed);
+    deque->status.store(OK, std::memory_order_relaxed);
+    deque->reallocs   = 0;
+    deque->poison_top = 0;
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int WorkDequeDtor(WorkDeque* deque)
+{
+    assert(deque);
+
+    DequeBuffer* buffer = deque->buffer.load(std::memory_order_relaxed);
+
+    while (buffer != nullptr)
+    {
+        DequeBuffer* retired = buffer->retired;
+        BufferDtor(buffer);
+        buffer = retired;
+    }
+
+    deque->buffer.store(nullptr, std::memory_order_relaxed);
+    deque->top.store(0, std::memory_order_relaxed);
+    deque->bottom.store(0, std::memory_order_relaxed);
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int WorkDequePush(WorkDeque* deque, elem_t value)
+{
+    assert(deque);
+
+    int64_t bottom      = deque->bottom.load(std::memory_order_relaxed);
+    int64_t top         = deque->top.load(std::memory_order_acquire);
+    DequeBuffer* buffer = deque->buffer.load(std::memory_order_relaxed);
+
+    ON_DEQUE_VALIDATE
+    (
+        CHECK_DEQUE(deque, buffer);
+        PoisonStolen(deque, buffer)
+    );
+
+    if (bottom - top >= (int64_t) buffer->capacity)
+    {
+        buffer = GrowBuffer(deque, buffer, top, bottom);
+
+        if (buffer == nullptr)
+            return (int) ERRORS::ALLOCATE_MEMORY;
+    }
+
+    StoreSlot(buffer, bottom, value);
+
+    // thief, that sees new bottom, must see element
+    std::atomic_thread_fence(std::memory_order_release);
+    deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int WorkDequePop(WorkDeque* deque, elem_t* ret_value)
+{
+    assert(deque);
+    assert(ret_value);
+
+    int64_t bottom      = deque->bottom.load(std::memory_order_relaxed) - 1;
+    DequeBuffer* buffer = deque->buffer.load(std::memory_order_relaxed);
+
+    ON_DEQUE_VALIDATE
+    (
+        CHECK_DEQUE(deque, buffer)
+    );
+
+    deque->bottom.store(bottom, std::memory_order_relaxed);
+
+    // bottom must be published before top is read, otherwise owner and thief can take one element
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = deque->top.load(std::memory_order_relaxed);
+
+    if (top > bottom)
+    {
+        deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+        return (int) ERRORS::EMPTY_STACK;
+    }
+
+    elem_t value = LoadSlot(buffer, bottom);
+
+    if (top == bottom)
+    {
+        // last element, thieves race for it
+        bool won = deque->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                                   std::memory_order_relaxed);
+        deque->bottom.store(bottom + 1, std::memory_order_relaxed);
+
+        if (!won)
+            return (int) ERRORS::EMPTY_STACK;
+    }
+
+    ON_DEQUE_VALIDATE
+    (
+        if (value == POISON) return REPORT_CORRUPTION(deque, POISON_ACCESS);
+
+        StoreSlot(buffer, bottom, POISON);
+        PoisonStolen(deque, buffer)
+    );
+
+    *(ret_value) = value;
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int WorkDequeSteal(WorkDeque* deque, elem_t* ret_value)
+{
+    assert(deque);
+    assert(ret_value);
+
+    while (true)
+    {
+        int64_t top = deque->top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = deque->bottom.load(std::memory_order_acquire);
+
+        if (top >= bottom)
+            return (int) ERRORS::EMPTY_STACK;
+
+        DequeBuffer* buffer = deque->buffer.load(std::memory_order_acquire);
+        elem_t value        = LoadSlot(buffer, top);
+
+        if (!deque->top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                              std::memory_order_relaxed))
+            continue;
+
+        ON_DEQUE_VALIDATE
+        (
+            if (value == POISON) return REPORT_CORRUPTION(deque, POISON_ACCESS)
+        );
+
+        *(ret_value) = value;
+
+        return (int) ERRORS::NONE;
+    }
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+size_t WorkDequeSize(const WorkDeque* deque)
+{
+    assert(deque);
+
+    int64_t top    = deque->top.load(std::memory_order_acquire);
+    int64_t bottom = deque->bottom.load(std::memory_order_acquire);
+
+    return (bottom > top) ? (size_t) (bottom - top) : 0;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int WorkDequeDump(FILE* fp, const void* work_deque, const char* func, const char* file, const int line)
+{
+    assert(work_deque);
+    assert(func);
+    assert(file);
+
+    const WorkDeque* deque    = (const WorkDeque*) work_deque;
+    const DequeBuffer* buffer = deque->buffer.load(std::memory_order_acquire);
+
+    int64_t top    = deque->top.load(std::memory_order_acquire);
+    int64_t bottom = deque->bottom.load(std::memory_order_acquire);
+
+    LOG_START_MOD(func, file, line);
+
+    fprintf(fp, "WorkDeque            > [%p]\n"
+                "top                  > %lld\n"
+                "bottom               > %lld\n"
+                "capacity             > %zu\n"
+                "buffer place         > [%p]\n"
+                "reallocs             > %zu\n",
+                deque, (long long) top, (long long) bottom, buffer->capacity, buffer, deque->reallocs);
+
+    ON_CANARY
+    (
+        fprintf(fp, "DEQUE PREFIX CANARY  > %llX\n"
+                    "DEQUE POSTFIX CANARY > %llX\n"
+                    "PREFIX DATA CANARY   > %llX\n"
+                    "POSTFIX DATA CANARY  > %llX\n",
+                    deque->deque_prefix, deque->deque_postfix,
+                    *GetPrefixBufferCanary(buffer), *GetPostfixBufferCanary(buffer))
+    );
+
+    fprintf(fp, "ELEMENTS: \n\n");
+
+    for (int64_t index = top; index < bottom && index - top < (int64_t) buffer->capacity; index++)
+        fprintf(fp, "[%lld] " PRINT_ELEM_T "\n", (long long) index, LoadSlot(buffer, index));
+
+    if (deque->status.load(std::memory_order_relaxed) != OK)
+        PrintDequeCondition(deque);
+
+    LOG_END();
+
+    return (int) ERRORS::NONE;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+int WorkDequeOk(const WorkDeque* work_deque)
+{
+    assert(work_deque);
+
+#pragma GCC diagnostic ignored "-Wcast-qual"
+    WorkDeque* deque = (WorkDeque*) work_deque;
+#pragma GCC diagnostic warning "-Wcast-qual"
+
+    DequeBuffer* buffer = deque->buffer.load(std::memory_order_acquire);
+    int condition       = DequeCheck(deque, buffer);
+
+    ON_DEQUE_VALIDATE
+    (
+        PoisonStolen(deque, buffer);
+
+        int64_t top    = deque->top.load(std::memory_order_acquire);
+        int64_t bottom = deque->bottom.load(std::memory_order_acquire);
+
+        for (int64_t index = bottom; index < top + (int64_t) buffer->capacity; index++)
+            if (LoadSlot(buffer, index) != POISON) condition |= POISON_ACCESS
+    );
+
+    deque->status.fetch_or(condition, std::memory_order_relaxed);
+
+    return deque->status.load(std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static DequeBuffer* BufferCtor(const size_t capacity)
+{
+    size_t size = sizeof(DequeBuffer) + capacity * sizeof(std::atomic<elem_t>);
+
+    ON_CANARY
+    (
+        size += 2 * sizeof(canary_t)
+    );
+
+    DequeBuffer* buffer = (DequeBuffer*) calloc(1, size);
+
+    if (buffer == nullptr)
+        return nullptr;
+
+    char* data = (char*) buffer + sizeof(DequeBuffer);
+
+    ON_CANARY
+    (
+        *(canary_t*) data = canary_val;
+        data += sizeof(canary_t);
+        *(canary_t*)(data + capacity * sizeof(std::atomic<elem_t>)) = canary_val
+    );
+
+    buffer->capacity = capacity;
+    buffer->data     = (std::atomic<elem_t>*) data;
+    buffer->retired  = nullptr;
+
+    for (size_t i = 0; i < capacity; i++)
+        buffer->data[i].store(POISON, std::memory_order_relaxed);
+
+    return buffer;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static void BufferDtor(DequeBuffer* buffer)
+{
+    free(buffer);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static DequeBuffer* GrowBuffer(WorkDeque* deque, DequeBuffer* buffer, const int64_t top, const int64_t bottom)
+{
+    assert(deque);
+    assert(buffer);
+
+    DequeBuffer* new_buffer = BufferCtor(buffer->capacity * 2);
+
+    if (new_buffer == nullptr)
+        return nullptr;
+
+    // elements, that are stolen during copying, are copied too, they are never read from new buffer
+    for (int64_t index = top; index < bottom; index++)
+        StoreSlot(new_buffer, index, LoadSlot(buffer, index));
+
+    new_buffer->retired = buffer;
+    deque->reallocs++;
+    deque->poison_top = top;
+
+    deque->buffer.store(new_buffer, std::memory_order_release);
+
+    return new_buffer;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline elem_t LoadSlot(const DequeBuffer* buffer, const int64_t index)
+{
+    return buffer->data[(size_t) index & (buffer->capacity - 1)].load(std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static inline void StoreSlot(DequeBuffer* buffer, const int64_t index, const elem_t value)
+{
+    buffer->data[(size_t) index & (buffer->capacity - 1)].store(value, std::memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+#if CANARY_PROTECT
+static canary_t* GetPrefixBufferCanary(const DequeBuffer* buffer)
+{
+    assert(buffer);
+
+    return (canary_t*) buffer->data - 1;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static canary_t* GetPostfixBufferCanary(const DequeBuffer* buffer)
+{
+    assert(buffer);
+
+    return (canary_t*) (buffer->data + buffer->capacity);
+}
+#endif
+
+//-----------------------------------------------------------------------------------------------------
+
+static int DequeCheck(const WorkDeque* deque, const DequeBuffer* buffer)
+{
+    assert(deque);
+
+    int condition = OK;
+
+    if (buffer == nullptr || buffer->data == nullptr)
+        return INVALID_DATA;
+
+    if ((buffer->capacity & (buffer->capacity - 1)) != 0)
+        condition |= INVALID_CAPACITY;
+
+    ON_CANARY
+    (
+        if (deque->deque_prefix != canary_val || deque->deque_postfix != canary_val)
+            condition |= STACK_CANARY_TRIGGER;
+
+        if (*GetPrefixBufferCanary(buffer) != canary_val || *GetPostfixBufferCanary(buffer) != canary_val)
+            condition |= DATA_CANARY_TRIGGER
+    );
+
+    return condition;
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+#if DEQUE_VALIDATE
+static void PoisonStolen(WorkDeque* deque, DequeBuffer* buffer)
+{
+    assert(deque);
+    assert(buffer);
+
+    // thieves never read slots below top after their CAS, so owner can poison them
+    int64_t top = deque->top.load(std::memory_order_acquire);
+
+    for (; deque->poison_top < top; deque->poison_top++)
+        StoreSlot(buffer, deque->poison_top, POISON);
+}
+
+//-----------------------------------------------------------------------------------------------------
+
+static int ReportCorruption(WorkDeque* deque, const int condition,
+                            const char* func, const char* file, const int line)
+{
+    assert(deque);
+
+    deque->status.fetch_or(condition, std::memory_order_relaxed);
+
+    LogDump(WorkDequeDump, deque, func, file, line);
+
+    return (int) ERRORS::INVALID_STACK;
+}
+
+#endif
+
+//-----------------------------------------------------------------------------------------------------
+
+static void PrintDequeCondition(const WorkDeque* deque)
+{
+    assert(deque);
+
+    int status = deque->status.load(std::memory_order_relaxed);
+
+    PrintLog("\n>>>>>>>>>>STACK CONDITIONS<<<<<<<<<\n");
+
+    if ((status & INVALID_CAPACITY) != 0)
+        PrintLog("INVALID DEQUE CAPACITY\n");
+
+    if ((status & INVALID_DATA) != 0)
+        PrintLog("INVALID DEQUE BUFFER\n");
+
+    if ((status & POISON_ACCESS) != 0)
+        PrintLog("CAN NOT ACCESS TO POISONED ELEMENT\n");
+
+    if ((status & DATA_CANARY_TRIGGER) != 0)
+        PrintLog("DATA CANARY TRIGGERED\n");
+
+    if ((status & STACK_CANARY_TRIGGER) != 0)
+        PrintLog("DEQUE CANARY TRIGGERED\n");
+
+    PrintLog(">>>>>>>>STACK CONDITIONS END<<<<<<<\n\n");
+}
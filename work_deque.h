@@ -0,0 +1,156 @@
+#ifndef __WORK_DEQUE_H_
+#define __WORK_DEQUE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+
+#include "stack.h"
+
+/*! \file
+* \brief Contains Chase-Lev work-stealing deque
+*
+* Owner thread pushes and pops elements at bottom without locks, other threads steal elements from top.
+* Buffer is a circular array, that grows twice, when it is full (like stack data in StackRealloc).
+* Old buffers are kept until WorkDequeDtor, because thieves can still read them.
+*/
+
+#ifndef DEQUE_VALIDATE
+/************************************************************//**
+ * @brief Canary and poison validation of work deque (ON in debug builds, like assert)
+ *
+ * 1 for ON
+ * 0 for OFF
+ ************************************************************/
+#ifdef NDEBUG
+#define DEQUE_VALIDATE 0
+
+#else
+#define DEQUE_VALIDATE 1
+#endif
+
+#endif
+
+#if DEQUE_VALIDATE
+#define ON_DEQUE_VALIDATE(...) __VA_ARGS__
+
+#else
+#define ON_DEQUE_VALIDATE(...) ;
+#endif
+
+/// minimum capacity of work deque (power of 2)
+static const size_t DEQUE_MIN_CAPACITY = 64;
+
+/// @brief circular buffer of work deque (elements are placed after it, between data canaries)
+struct DequeBuffer
+{
+    /// capacity (power of 2)
+    size_t capacity;
+    /// elements
+    std::atomic<elem_t>* data;
+    /// buffer, that was replaced by this one
+    DequeBuffer* retired;
+};
+
+/// @brief work-stealing deque
+struct WorkDeque
+{
+    ON_CANARY
+    (
+        /// deque prefix canary
+        canary_t deque_prefix;
+    )
+
+    /// index of first element (thieves take it)
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> top;
+    /// index after last element (owner pushes and pops there)
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> bottom;
+    /// current buffer
+    std::atomic<DequeBuffer*> buffer;
+    /// deque status (0 if everything is fine)
+    std::atomic<int> status;
+    /// buffer reallocations
+    size_t reallocs;
+    /// slots before this index, that were taken by thieves, are poisoned (owner only)
+    int64_t poison_top;
+
+    ON_CANARY
+    (
+        /// deque postfix canary
+        canary_t deque_postfix;
+    )
+};
+
+/************************************************************//**
+ * @brief Creates work deque
+ *
+ * @param[in] deque deque pointer
+ * @param[in] capacity start capacity (rounded up to power of 2)
+ * @return int error code
+ ************************************************************/
+int WorkDequeCtor(WorkDeque* deque, size_t capacity = DEQUE_MIN_CAPACITY);
+
+/************************************************************//**
+ * @brief Destroys work deque (no other thread may use it)
+ *
+ * @param[in] deque deque pointer
+ * @return int error code
+ ************************************************************/
+int WorkDequeDtor(WorkDeque* deque);
+
+/************************************************************//**
+ * @brief Pushes element at bottom (owner thread only)
+ *
+ * @param[in] deque deque pointer
+ * @param[in] value element
+ * @return int error code
+ ************************************************************/
+int WorkDequePush(WorkDeque* deque, elem_t value);
+
+/************************************************************//**
+ * @brief Pops element from bottom (owner thread only)
+ *
+ * @param[in] deque deque pointer
+ * @param[out] ret_value popped element
+ * @return int error code (ERRORS::EMPTY_STACK, if deque is empty)
+ ************************************************************/
+int WorkDequePop(WorkDeque* deque, elem_t* ret_value);
+
+/************************************************************//**
+ * @brief Steals element from top (any thread, steal, that lost race with other thread, is retried)
+ *
+ * @param[in] deque deque pointer
+ * @param[out] ret_value stolen element
+ * @return int error code (ERRORS::EMPTY_STACK, if deque is empty)
+ ************************************************************/
+int WorkDequeSteal(WorkDeque* deque, elem_t* ret_value);
+
+/************************************************************//**
+ * @brief Counts amount of elements (exact only, if deque is not changed by other threads)
+ *
+ * @param[in] deque deque pointer
+ * @return size_t amount of elements
+ ************************************************************/
+size_t WorkDequeSize(const WorkDeque* deque);
+
+/************************************************************//**
+ * @brief Prints info about work deque in output stream
+ *
+ * @param[in] fp output stream
+ * @param[in] deque deque pointer
+ * @param[in] func function, where print called
+ * @param[in] file file, where print called
+ * @param[in] line line, where print caled
+ * @return int error code
+ ************************************************************/
+int WorkDequeDump(FILE* fp, const void* deque, const char* func, const char* file, const int line);
+
+/************************************************************//**
+ * @brief Verifies canaries of deque and buffer, poison of empty slots (no other thread may use deque)
+ *
+ * @param[in] deque deque pointer
+ * @return int deque condition code
+ ************************************************************/
+int WorkDequeOk(const WorkDeque* deque);
+
+#endif